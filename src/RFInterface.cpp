@@ -1,385 +1,351 @@
 #include <cstring>
 #include <cstdio>
-#include <cstdarg>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <errno.h>
-#include <sys/select.h>
 
 #include <thread>
 #include <chrono>
 #include <iostream>
-#include <sstream>
 
 #include "RFInterface.hpp"
-#include "joystick.hpp"
+#include "logger.hpp"
 
 namespace RF {
 
-// Static socket pool
-static SocketPool* g_socket_pool = nullptr;
-
-RFInterface::RFInterface(const char* rf_ip, uint16_t rf_port) 
+RFInterfaceBase::RFInterfaceBase(const char* rf_ip, uint16_t rf_port, const RFConfig& config) 
     : rf_server_ip(rf_ip),
       rf_server_port(rf_port),
-      sock_fd(-1),
+      m_running(false),
+      m_scheduler(config.update_rate_hz, (int64_t)config.spin_us * 1000),
+      m_config(config),
       m_connected(false),
-      m_joystick("/dev/input/event0") 
+      m_superseded(0),
+      m_faults(0),
+      m_fanout_busy(false),
+      m_frame_seq(0),
+      m_rt_pending(false),
+      m_last_exchange_ns(0),
+      m_parsed_ns(0),
+      m_frame_kind(FRAME_NEW),
+      m_record_seq(0),
+      m_recorded_exchanges(0),
+      m_last_input_ns(0),
+      m_dumping(false),
+      m_timeouts(0)
 {
     memset(&state, 0, sizeof(state));
+    for (size_t i = 0; i < MAX_SUBSCRIBERS; i++) {
+        m_subscribers[i].store(nullptr);
+    }
     memset(reply_buffer, 0, sizeof(reply_buffer));
-    
-    bool init_ok = false;
+    m_request[0] = '\0';
+    m_body[0] = '\0';
+    m_command.cmd = neutral_cmd();
+    m_command.stamp_ns = 0;
+    m_command.seq = 0;
+    
+    if (m_config.shm_name && m_shm.open(m_config.shm_name, m_config.shm_history)) {
+        std::cout << "[INFO] RFInterface: publishing telemetry to shm " << m_config.shm_name << std::endl;
+    }
 
-    // Initialize socket pool (pool size of 3 sockets)
-    if (!g_socket_pool) {
-        g_socket_pool = new SocketPool(rf_ip, rf_port, 3);
+    if (m_config.record_path &&
+        m_recorder.open(m_config.record_path, (size_t)m_config.record_file_mb << 20,
+                        m_config.record_keep_files, m_config.record_sync_s)) {
+        std::cout << "[INFO] RFInterface: recording to " << m_recorder.file_path(0) << std::endl;
     }
 
-    init_ok = (g_socket_pool == nullptr) ? false : true;
-        
-    if(init_ok &= connect()) {
-        std::cout << "RFInterface initialized for " << rf_ip << ":" << rf_port << std::endl;
+    // The log is one more subscriber; a few blocks of slack for a slow disk
+    if (m_config.column_log_path) {
+        m_column_log_ring = subscribe(4 * (size_t)m_config.column_log_block_frames);
+        if (m_column_log_ring &&
+            m_column_log.open(m_config.column_log_path, m_column_log_ring, m_config.column_log_block_frames)) {
+            std::cout << "[INFO] RFInterface: logging frames to " << m_config.column_log_path << std::endl;
+        }
+    }
+
+    if (m_config.phase_timing && m_config.phase_dump_s > 0.0) {
+        m_dumping = true;
+        m_dump_thread = std::thread(&RFInterfaceBase::dump_phases, this);
     }
+}
 
-    // while(!m_joystick.is_reading()) {
-    //     // std::cout << "[UPDATE] RFInterface Waiting on Joystick to begin reading" << std::endl;
-    //     // std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    // }
 
-    if (init_ok) {
-        m_update_thread = std::thread(&RFInterface::update, this);
-        std::cout << "[SUCCESS] RFInterface Connected Successfully" <<  std::endl;
-    } else {
-        std::cout << "[ERROR] RFInterface Initialization Failed" <<  std::endl;
+RFInterfaceBase::~RFInterfaceBase() {
+    stop_update();
+    m_dumping = false;
+    if (m_dump_thread.joinable()) {
+        m_dump_thread.join();
+    }
+    m_recorder.close();
+    if (m_column_log_ring) {
+        m_column_log.close();
+        unsubscribe(m_column_log_ring);
     }
 }
 
 
-RFInterface::~RFInterface() {
-    disconnect();
-    m_joystick.stop_reading();
+void RFInterfaceBase::print_phases(std::ostream& os) const {
+    LatencyHistogram::Snapshot snaps[NUM_PHASES];
+    m_phase_stats.snapshot(snaps);
+    PhaseStats::print_json(os, snaps);
+    os << std::endl;
 }
 
-bool RFInterface::isRFConnected() {
-    return m_connected;
+
+void RFInterfaceBase::print_input_latency(std::ostream& os) const {
+    LatencyHistogram::Snapshot sent, parsed;
+    m_input_to_sent.snapshot(sent);
+    m_input_to_parsed.snapshot(parsed);
+    os << "{";
+    PhaseStats::print_entry(os, "", "to_sent", sent);
+    PhaseStats::print_entry(os, ",", "to_parsed", parsed);
+    os << "}" << std::endl;
 }
 
 
-void RFInterface::update() {
-    while(m_connected) {
-        RFCmd cmd = m_joystick.getJoystickVals();
-        // std::cout << "\n\n===========\n" << 
-        // "Joy Command:\n" <<  
-        // "Aileron: " << cmd.aileron << "\n" <<
-        // "Elevator: " << cmd.elevator << "\n" <<
-        // "Rudder: " << cmd.rudder << "\n" <<
-        // "Throttle: " << cmd.throttle << "\n" <<
-        // "=============\n\n" << std::endl;
+// Dump thread: every phase_dump_s, one JSON line with the phases and input latency
+// of that interval. Only reads the histograms, so the update thread never waits for it.
+void RFInterfaceBase::dump_phases() {
+    // Phases, then input to sent / parsed
+    const int count = NUM_PHASES + 2;
+    std::vector<LatencyHistogram::Snapshot> prev(count), cur(count);
+    m_phase_stats.snapshot(&prev[0]);
+    m_input_to_sent.snapshot(prev[NUM_PHASES]);
+    m_input_to_parsed.snapshot(prev[NUM_PHASES + 1]);
+    int64_t next = monotonic_ns() + (int64_t)(m_config.phase_dump_s * 1e9);
 
-        exchange_data(cmd);
+    while (m_dumping) {
+        if (monotonic_ns() < next) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            continue;
+        }
+        next += (int64_t)(m_config.phase_dump_s * 1e9);
 
-        // Works better without sleep
-        // std::this_thread::sleep_for(10ms);
+        m_phase_stats.snapshot(&cur[0]);
+        m_input_to_sent.snapshot(cur[NUM_PHASES]);
+        m_input_to_parsed.snapshot(cur[NUM_PHASES + 1]);
+        std::vector<LatencyHistogram::Snapshot> interval(cur);
+        for (int i = 0; i < count; i++) {
+            interval[i].subtract(prev[i]);
+        }
+        prev.swap(cur);
+
+        std::cout << "{\"rf_phases\":";
+        PhaseStats::print_json(std::cout, &interval[0]);
+        std::cout << ",\"input\":{";
+        PhaseStats::print_entry(std::cout, "", "to_sent", interval[NUM_PHASES]);
+        PhaseStats::print_entry(std::cout, ",", "to_parsed", interval[NUM_PHASES + 1]);
+        std::cout << "},\"frames\":";
+        PhysicsClock::print_json(std::cout, m_physics.stats());
+        std::cout << ",\"interval_s\":" << m_config.phase_dump_s << "}" << std::endl;
     }
 }
 
 
-bool RFInterface::connect() {
-    // Inject the UAV controller interface to take over from the internal RC
-    const char* empty_body = "";
-    if (!soap_request_start("InjectUAVControllerInterface", empty_body)) {
-        std::cerr << "Failed to send InjectUAVControllerInterface request" << std::endl;
-        return false;
+void RFInterfaceBase::stop_update() {
+    m_running = false;
+    if (m_update_thread.joinable()) {
+        m_update_thread.join();
     }
-    
-    char* response = soap_request_end(1000);
-    if (!response) {
-        std::cerr << "Failed to receive InjectUAVControllerInterface response" << std::endl;
-        return false;
+}
+
+bool RFInterfaceBase::isRFConnected() {
+    return m_connected;
+}
+
+
+StateFrame RFInterfaceBase::get_state() const {
+    StateFrame frame;
+    m_published.load(frame);
+    return frame;
+}
+
+
+std::shared_ptr<TelemetryRing> RFInterfaceBase::subscribe(size_t depth) {
+    std::lock_guard<std::mutex> lock(m_subscribe_mutex);
+    for (size_t i = 0; i < MAX_SUBSCRIBERS; i++) {
+        if (!m_subscriber_refs[i]) {
+            m_subscriber_refs[i] = std::make_shared<TelemetryRing>(depth);
+            m_subscribers[i].store(m_subscriber_refs[i].get());
+            return m_subscriber_refs[i];
+        }
     }
-    
-    // Check if response indicates success (200 status)
-    if (strstr(response, "200 OK") != nullptr) {
-        std::cout << "External control enabled (RealFlight Link active)" << std::endl;
-        m_connected = true;
-        return true;
+    return nullptr;
+}
+
+
+void RFInterfaceBase::unsubscribe(const std::shared_ptr<TelemetryRing>& ring) {
+    std::lock_guard<std::mutex> lock(m_subscribe_mutex);
+    for (size_t i = 0; i < MAX_SUBSCRIBERS; i++) {
+        if (ring && m_subscriber_refs[i] == ring) {
+            m_subscribers[i].store(nullptr);
+            // Let a fan-out that may still hold the pointer finish with it
+            while (m_fanout_busy.load()) {
+                std::this_thread::yield();
+            }
+            m_subscriber_refs[i].reset();
+            return;
+        }
     }
-    
-    std::cerr << "InjectUAVControllerInterface request failed" << std::endl;
-    return false;
 }
 
 
-bool RFInterface::disconnect() {
-    // Restore the original controller device (joystick/RC)
-    const char* empty_body = "";
-    if (!soap_request_start("RestoreOriginalControllerDevice", empty_body)) {
-        std::cerr << "Failed to send RestoreOriginalControllerDevice request" << std::endl;
+// Start of the update thread
+bool RFInterfaceBase::begin_update() {
+    prefault_stack();
+
+    // With a jitter window the first window is measured before going realtime
+    m_rt_pending = (m_config.jitter_window > 0);
+    m_last_exchange_ns = 0;
+
+    m_scheduler.start();
+    return !m_rt_pending;
+}
+
+
+// After every exchange
+bool RFInterfaceBase::end_exchange() {
+    if (m_config.jitter_window == 0) {
         return false;
     }
-    
-    char* response = soap_request_end(1000);
-    if (!response) {
-        std::cerr << "Failed to receive RestoreOriginalControllerDevice response" << std::endl;
+
+    int64_t now = monotonic_ns();
+    if (m_last_exchange_ns != 0) {
+        m_jitter.add(now - m_last_exchange_ns);
+    }
+    m_last_exchange_ns = now;
+
+    if (m_jitter.count() < m_config.jitter_window) {
         return false;
     }
-    
-    // Check if response indicates success (200 status)
-    if (strstr(response, "200 OK") != nullptr) {
-        std::cout << "External control disabled (internal RC/joystick active)" << std::endl;
-        m_connected = false;
+    m_jitter.print(std::cout, m_rt_pending ? "before realtime settings" : "after realtime settings");
+    m_jitter.reset();
+    if (m_rt_pending) {
+        m_rt_pending = false;
+        m_last_exchange_ns = 0;
         return true;
     }
-    
-    std::cerr << "RestoreOriginalControllerDevice request failed" << std::endl;
     return false;
 }
 
 
-
-bool RFInterface::reset_aircraft() {
-    // Reset aircraft position (equivalent to pressing spacebar in RealFlight)
-    const char* empty_body = "";
-    if (!soap_request_start("ResetAircraft", empty_body)) {
-        std::cerr << "Failed to send ResetAircraft request" << std::endl;
-        return false;
+// Called from the update thread: pin and prioritise it and lock the hot buffers in
+// memory
+void RFInterfaceBase::apply_realtime() {
+    if (m_config.lock_memory) {
+        // MCL_CURRENT faults in every page mapped so far, the request and reply
+        // buffers included: nothing to touch by hand (and they may be in use by a
+        // request on another thread right now)
+        if (lock_memory()) {
+            std::cout << "[INFO] RFInterface: memory locked" << std::endl;
+        }
     }
-    
-    char* response = soap_request_end(1000);
-    if (!response) {
-        std::cerr << "Failed to receive ResetAircraft response" << std::endl;
-        return false;
+    if (!m_config.update_thread.is_default()) {
+        apply_thread_config(pthread_self(), m_config.update_thread, "rf_update");
     }
-    
-    // Check if response indicates success (200 status)
-    if (strstr(response, "200 OK") != nullptr) {
-        std::cout << "Aircraft reset to initial position" << std::endl;
-        return true;
-    }
-    
-    std::cerr << "ResetAircraft request failed" << std::endl;
-    return false;
 }
 
 
-bool RFInterface::soap_request_start(const char *action, const char *fmt, ...) {
-    // Get socket from pool
-    sock_fd = g_socket_pool->get_socket();
-    if (sock_fd < 0) {
-        std::cerr << "Failed to get socket from pool" << std::endl;
+bool RFInterfaceBase::reply_ok(const char *action, const char *response) {
+    if (!response) {
+        RF_LOG(LOG_ERROR, "RFInterface: failed to receive %s response", action);
         return false;
     }
-    
-    // Build the SOAP body
-    char body[1024];
-    if (fmt && strlen(fmt) > 0) {
-        va_list args;
-        va_start(args, fmt);
-        vsnprintf(body, sizeof(body), fmt, args);
-        va_end(args);
-    } else {
-        body[0] = '\0';
-    }
-    
-    // Build SOAP envelope
-    std::stringstream envelope;
-    envelope << "<?xml version='1.0' encoding='UTF-8'?>"
-             << "<soap:Envelope xmlns:soap='http://schemas.xmlsoap.org/soap/envelope/' "
-             << "xmlns:xsd='http://www.w3.org/2001/XMLSchema' "
-             << "xmlns:xsi='http://www.w3.org/2001/XMLSchema-instance'>"
-             << "<soap:Body>"
-             << "<" << action << ">" << body << "</" << action << ">"
-             << "</soap:Body>"
-             << "</soap:Envelope>";
-    
-    std::string envelope_str = envelope.str();
-    
-    // Build HTTP request
-    std::stringstream request;
-    request << "POST / HTTP/1.1\r\n"
-            << "Soapaction: '" << action << "'\r\n"
-            << "Content-Length: " << envelope_str.length() << "\r\n"
-            << "Content-Type: text/xml;charset=utf-8\r\n"
-            << "\r\n"
-            << envelope_str;
-    
-    std::string request_str = request.str();
-    
-    // Send request
-    ssize_t sent = send(sock_fd, request_str.c_str(), request_str.length(), 0);
-    if (sent < 0) {
-        std::cerr << "Failed to send SOAP request: " << strerror(errno) << std::endl;
-        close(sock_fd);
-        sock_fd = -1;
+
+    // Check if response indicates success (200 status)
+    if (strstr(response, "200 OK") == nullptr) {
+        RF_LOG(LOG_ERROR, "RFInterface: %s request failed", action);
         return false;
     }
-    
     return true;
 }
 
 
-char* RFInterface::soap_request_end(uint32_t timeout_ms) {
-    if (sock_fd < 0) {
-        return nullptr;
-    }
-    
-    memset(reply_buffer, 0, sizeof(reply_buffer));
-    
-    // Read response with timeout
-    fd_set readfds;
-    struct timeval tv;
-    
-    FD_ZERO(&readfds);
-    FD_SET(sock_fd, &readfds);
-    
-    tv.tv_sec = timeout_ms / 1000;
-    tv.tv_usec = (timeout_ms % 1000) * 1000;
-    
-    int ready = select(sock_fd + 1, &readfds, nullptr, nullptr, &tv);
-    if (ready <= 0) {
-        std::cerr << "Timeout or error waiting for response" << std::endl;
-        close(sock_fd);
-        sock_fd = -1;
+const char* RFInterfaceBase::build_request(const char *action, const char *body, size_t& len) {
+    // SOAP envelope in an HTTP POST (see soapcodec.hpp)
+    len = write_request(action, body, m_request, sizeof(m_request));
+    if (len >= sizeof(m_request)) {
         return nullptr;
     }
-    
-    // Read response
-    size_t total_received = 0;
-    ssize_t n;
-    
-    while (total_received < sizeof(reply_buffer) - 1) {
-        n = recv(sock_fd, reply_buffer + total_received, sizeof(reply_buffer) - total_received - 1, 0);
-        
-        if (n <= 0) {
-            break;
-        }
-        
-        total_received += n;
-        
-        // Check if we've received the complete response
-        if (strstr(reply_buffer, "</SOAP-ENV:Envelope>") != nullptr) {
-            break;
-        }
-    }
-    
-    // Close socket (don't return to pool. RealFlight requires new connection per request)
-    close(sock_fd);
-    sock_fd = -1;
-    
-    if (total_received > 0) {
-        reply_buffer[total_received] = '\0';
-        return reply_buffer;
-    }
-    
-    return nullptr;
+    return m_request;
 }
 
 
-void RFInterface::exchange_data(const struct RFCmd &input) {
-    // Build control inputs XML
-    std::stringstream body;
-    body << "<pControlInputs>"
-         << "<m-selectedChannels>4095</m-selectedChannels>"
-         << "<m-channelValues-0to1>";
-    
-    // Map control inputs to channels (0.0 to 1.0 range)
-    double channels[12] = {
-        0.5,
-        0.5,
-        0.5, 
-        0.5, 
-        0.5, 
-        0.5, 
-        0.5, 
-        0, // Mode: Stability Control toggle. Different modes, order for different planes
-        0.5, 
-        0.5, 
-        0.5, 
-        0.5};
-    
-    // Map inputs to appropriate channels
-    channels[0] = input.aileron;   // Roll
-    channels[1] = input.elevator;  // Pitch
-    channels[2] = input.throttle;  // Throttle
-    channels[3] = input.rudder;    // Yaw
-    channels[4] = input.flaps;
-    channels[5] = input.gear;
-    
-    for (int i = 0; i < 12; i++) {
-        body << "<item>" << channels[i] << "</item>";
+char* RFInterfaceBase::finish_request(const char *action, ssize_t n) {
+    if (n == -ETIMEDOUT) {
+        m_timeouts++;
     }
-    
-    body << "</m-channelValues-0to1>"
-         << "</pControlInputs>";
-    
-    std::string body_str = body.str();
-    
-    // Send SOAP request
-    if (!soap_request_start("ExchangeData", body_str.c_str())) {
-        std::cerr << "Failed to start SOAP request" << std::endl;
-        return;
+    if (n <= 0) {
+        // Every frame while RealFlight is away: rate limited, off the update thread
+        RF_LOG(LOG_ERROR, "RFInterface: SOAP request %s failed: %s", action, strerror(n < 0 ? -n : EIO));
+        return nullptr;
     }
     
-    // Get response
-    char* response = soap_request_end(1000);  // 1 second timeout
-    
-    if (response) {
-        // std::cout << "\n=== Received SOAP Response ===" << std::endl;
-        // std::cout << response << std::endl;
-        // std::cout << "==============================\n" << std::endl;
-        
-        parse_reply(response);
-    } else {
-        std::cerr << "Failed to receive response" << std::endl;
+    return reply_buffer;
+}
+
+
+const char* RFInterfaceBase::exchange_body(const struct RFCmd &input) {
+    // Control inputs XML (see soapcodec.hpp), fits easily
+    write_controls(input, m_body, sizeof(m_body));
+    return m_body;
+}
+
+void RFInterfaceBase::parse_reply(const char *reply) {
+    parse_state_scan(reply, state);
+    m_parsed_ns = monotonic_ns();
+
+    m_frame_kind = m_physics.observe(state.m_currentPhysicsTime_SEC, m_parsed_ns);
+    m_record_seq = 0;
+    if (m_frame_kind != FRAME_DUPLICATE || m_config.publish_duplicates) {
+        publish_state();
+        m_record_seq = m_frame_seq;
     }
 }
 
-void RFInterface::parse_reply(const char *reply) {
-    // Lambda to extract values from xml tag
-    auto extract_value = [](const char* xml, const char* tag) -> double {
-        std::string search_tag = std::string("<") + tag + ">";
-        std::string end_tag = std::string("</") + tag + ">";
-        
-        const char* start = strstr(xml, search_tag.c_str());
-        if (!start) return 0.0;
-        
-        start += search_tag.length();
-        const char* end = strstr(start, end_tag.c_str());
-        if (!end) return 0.0;
-        
-        std::string value_str(start, end - start);
-        
-        // Handle boolean values
-        if (value_str == "true") return 1.0;
-        if (value_str == "false") return 0.0;
-        
-        try {
-            return std::stod(value_str);
-        } catch (...) {
-            return 0.0;
+
+// One fixed-size record into the mapping; the recorder's thread does the file work
+void RFInterfaceBase::record_flight(int64_t taken, const ExchangeTimes& times) {
+    FlightRecord record;
+    record.exchange = ++m_recorded_exchanges;
+    record.frame_seq = m_record_seq;
+    record.parsed_ns = m_parsed_ns;
+    record.frame_kind = m_frame_kind;
+    record.reserved = 0;
+    record.taken_ns = taken;
+    record.times = times;
+    record.cmd_stamp_ns = m_command.stamp_ns;
+    record.cmd_seq = m_command.seq;
+    record.cmd = m_command.cmd;
+    record.state = state;
+    m_recorder.append(record);
+}
+
+
+// Publish the parsed frame to readers on other threads in one consistent piece
+void RFInterfaceBase::publish_state() {
+    StateFrame frame;
+    frame.seq = ++m_frame_seq;
+    frame.stamp_ns = m_parsed_ns;
+    frame.state = state;
+    m_published.store(frame);
+
+    m_fanout_busy.store(true);
+    for (size_t i = 0; i < MAX_SUBSCRIBERS; i++) {
+        TelemetryRing* ring = m_subscribers[i].load();
+        if (ring) {
+            ring->push(frame);
         }
-    };
-    
-    // Parse all state values using the keytable
-    for (int i = 0; i < num_keys; i++) {
-        double value = extract_value(reply, keytable[i].key);
-        keytable[i].ref = value;
     }
-    
-    // Print some key values
-    // std::cout << "Aircraft State:" << std::endl;
-    // std::cout << "  Airspeed: " << state.m_airspeed_MPS << " m/s" << std::endl;
-    // std::cout << "  Altitude ASL: " << state.m_altitudeASL_MTR << " m" << std::endl;
-    // std::cout << "  Altitude AGL: " << state.m_altitudeAGL_MTR << " m" << std::endl;
-    // std::cout << "  Roll: " << state.m_roll_DEG << " deg" << std::endl;
-    // std::cout << "  Pitch: " << state.m_inclination_DEG << " deg" << std::endl;
-    // std::cout << "  Yaw: " << state.m_azimuth_DEG << " deg" << std::endl;
-    // std::cout << "  Touching Ground: " << (state.m_isTouchingGround > 0.5 ? "Yes" : "No") << std::endl;
-    // std::cout << "  Engine Running: " << (state.m_anEngineIsRunning > 0.5 ? "Yes" : "No") << std::endl;
+    m_fanout_busy.store(false, std::memory_order_release);
+
+    m_shm.publish(frame);
+
+    m_frame_notifier.notify(frame.seq);
 }
 
 } // namespace RF
@@ -8,164 +8,420 @@
 #include <atomic>
 #include <thread>
 #include <chrono>
+#include <memory>
+#include <iostream>
 
-#include "socketpool.hpp"
-#include "joystick.hpp"
+#include "transport.hpp"
+#include "epolltransport.hpp"
+#include "uringtransport.hpp"
+#include "loopbacktransport.hpp"
+#include "replaytransport.hpp"
+#include "rfconfig.hpp"
+#include "ratescheduler.hpp"
+#include "rfstate.hpp"
+#include "seqlock.hpp"
+#include "framenotifier.hpp"
+#include "spscring.hpp"
+#include "phasestats.hpp"
+#include "physicsclock.hpp"
+#include "flightrecorder.hpp"
+#include "columnlog.hpp"
+#include "shmtelemetry.hpp"
+#include "commandslot.hpp"
+#include "commandsource.hpp"
+#include "soapcodec.hpp"
+#include "logger.hpp"
 
 using namespace std::chrono;
 
 namespace RF {
 
-class RFInterface {
+// Per-subscriber queue of every published state frame
+typedef SpscRing<StateFrame> TelemetryRing;
+
+// Everything that depends on neither the command source nor the transport: building
+// SOAP requests, parsing replies and publishing state. Use BasicRFInterface.
+class RFInterfaceBase {
 public:
-    RFInterface(const char* rf_ip = "127.0.0.1", uint16_t rf_port = 18083);
-    ~RFInterface();
+    // Latest consistent state frame. Never blocks the exchange thread; seq is 0 until
+    // the first reply has been parsed.
+    StateFrame get_state() const;
 
-    // Main update method like the original
-    void update();
-    
-    // Control mode switching
-    bool connect();   // Connect and enable (RealFlight Link) control
-    bool disconnect();  // Disconnect & switch back to internal (joystick/RC) control
-    
-    // Aircraft control
-    bool reset_aircraft();  // Reset aircraft position (like pressing spacebar)
-
-    struct state {
-        double rcin[12];
-        double m_airspeed_MPS;
-        double m_altitudeASL_MTR;
-        double m_altitudeAGL_MTR;
-        double m_groundspeed_MPS;
-        double m_pitchRate_DEGpSEC;
-        double m_rollRate_DEGpSEC;
-        double m_yawRate_DEGpSEC;
-        double m_azimuth_DEG;
-        double m_inclination_DEG;
-        double m_roll_DEG;
-        double m_aircraftPositionX_MTR;
-        double m_aircraftPositionY_MTR;
-        double m_velocityWorldU_MPS;
-        double m_velocityWorldV_MPS;
-        double m_velocityWorldW_MPS;
-        double m_velocityBodyU_MPS;
-        double m_velocityBodyV_MPS;
-        double m_velocityBodyW_MPS;
-        double m_accelerationWorldAX_MPS2;
-        double m_accelerationWorldAY_MPS2;
-        double m_accelerationWorldAZ_MPS2;
-        double m_accelerationBodyAX_MPS2;
-        double m_accelerationBodyAY_MPS2;
-        double m_accelerationBodyAZ_MPS2;
-        double m_windX_MPS;
-        double m_windY_MPS;
-        double m_windZ_MPS;
-        double m_propRPM;
-        double m_heliMainRotorRPM;
-        double m_batteryVoltage_VOLTS;
-        double m_batteryCurrentDraw_AMPS;
-        double m_batteryRemainingCapacity_MAH;
-        double m_fuelRemaining_OZ;
-        double m_isLocked;
-        double m_hasLostComponents;
-        double m_anEngineIsRunning;
-        double m_isTouchingGround;
-        double m_currentAircraftStatus;
-        double m_currentPhysicsTime_SEC;
-        double m_currentPhysicsSpeedMultiplier;
-        double m_orientationQuaternion_X;
-        double m_orientationQuaternion_Y;
-        double m_orientationQuaternion_Z;
-        double m_orientationQuaternion_W;
-        double m_flightAxisControllerIsActive;
-        double m_resetButtonHasBeenPressed;
-    } state;
-
-    static const uint16_t num_keys = sizeof(state)/sizeof(double);
-
-    struct keytable {
-        const char *key;
-        double &ref;
-    } keytable[num_keys] = {
-        { "item", state.rcin[0] },
-        { "item", state.rcin[1] },
-        { "item", state.rcin[2] },
-        { "item", state.rcin[3] },
-        { "item", state.rcin[4] },
-        { "item", state.rcin[5] },
-        { "item", state.rcin[6] },
-        { "item", state.rcin[7] },
-        { "item", state.rcin[8] },
-        { "item", state.rcin[9] },
-        { "item", state.rcin[10] },
-        { "item", state.rcin[11] },
-        { "m-airspeed-MPS", state.m_airspeed_MPS },
-        { "m-altitudeASL-MTR", state.m_altitudeASL_MTR },
-        { "m-altitudeAGL-MTR", state.m_altitudeAGL_MTR },
-        { "m-groundspeed-MPS", state.m_groundspeed_MPS },
-        { "m-pitchRate-DEGpSEC", state.m_pitchRate_DEGpSEC },
-        { "m-rollRate-DEGpSEC", state.m_rollRate_DEGpSEC },
-        { "m-yawRate-DEGpSEC", state.m_yawRate_DEGpSEC },
-        { "m-azimuth-DEG", state.m_azimuth_DEG },
-        { "m-inclination-DEG", state.m_inclination_DEG },
-        { "m-roll-DEG", state.m_roll_DEG },
-        { "m-aircraftPositionX-MTR", state.m_aircraftPositionX_MTR },
-        { "m-aircraftPositionY-MTR", state.m_aircraftPositionY_MTR },
-        { "m-velocityWorldU-MPS", state.m_velocityWorldU_MPS },
-        { "m-velocityWorldV-MPS", state.m_velocityWorldV_MPS },
-        { "m-velocityWorldW-MPS", state.m_velocityWorldW_MPS },
-        { "m-velocityBodyU-MPS", state.m_velocityBodyU_MPS },
-        { "m-velocityBodyV-MPS", state.m_velocityBodyV_MPS },
-        { "m-velocityBodyW-MPS", state.m_velocityBodyW_MPS },
-        { "m-accelerationWorldAX-MPS2", state.m_accelerationWorldAX_MPS2 },
-        { "m-accelerationWorldAY-MPS2", state.m_accelerationWorldAY_MPS2 },
-        { "m-accelerationWorldAZ-MPS2", state.m_accelerationWorldAZ_MPS2 },
-        { "m-accelerationBodyAX-MPS2", state.m_accelerationBodyAX_MPS2 },
-        { "m-accelerationBodyAY-MPS2", state.m_accelerationBodyAY_MPS2 },
-        { "m-accelerationBodyAZ-MPS2", state.m_accelerationBodyAZ_MPS2 },
-        { "m-windX-MPS", state.m_windX_MPS },
-        { "m-windY-MPS", state.m_windY_MPS },
-        { "m-windZ-MPS", state.m_windZ_MPS },
-        { "m-propRPM", state.m_propRPM },
-        { "m-heliMainRotorRPM", state.m_heliMainRotorRPM },
-        { "m-batteryVoltage-VOLTS", state.m_batteryVoltage_VOLTS },
-        { "m-batteryCurrentDraw-AMPS", state.m_batteryCurrentDraw_AMPS },
-        { "m-batteryRemainingCapacity-MAH", state.m_batteryRemainingCapacity_MAH },
-        { "m-fuelRemaining-OZ", state.m_fuelRemaining_OZ },
-        { "m-isLocked", state.m_isLocked },
-        { "m-hasLostComponents", state.m_hasLostComponents },
-        { "m-anEngineIsRunning", state.m_anEngineIsRunning },
-        { "m-isTouchingGround", state.m_isTouchingGround },
-        { "m-currentAircraftStatus", state.m_currentAircraftStatus },
-        { "m-currentPhysicsTime-SEC", state.m_currentPhysicsTime_SEC },
-        { "m-currentPhysicsSpeedMultiplier", state.m_currentPhysicsSpeedMultiplier },
-        { "m-orientationQuaternion-X", state.m_orientationQuaternion_X },
-        { "m-orientationQuaternion-Y", state.m_orientationQuaternion_Y },
-        { "m-orientationQuaternion-Z", state.m_orientationQuaternion_Z },
-        { "m-orientationQuaternion-W", state.m_orientationQuaternion_W },
-        { "m-flightAxisControllerIsActive", state.m_flightAxisControllerIsActive },
-        { "m-resetButtonHasBeenPressed", state.m_resetButtonHasBeenPressed },
-    };
+    // Block until a frame newer than seq is published (or timeout_ms passes) and
+    // return the latest frame number. Woken directly by the update thread.
+    uint64_t wait_for_frame(uint64_t seq, uint32_t timeout_ms) { return m_frame_notifier.wait_for_frame(seq, timeout_ms); }
+
+    // eventfd that becomes readable whenever a frame is published, for epoll loops.
+    // Read 8 bytes from it to re-arm.
+    int frame_eventfd() { return m_frame_notifier.fd(); }
+
+    static const size_t MAX_SUBSCRIBERS = 16;
+
+    // Get every published frame in a ring of its own, filled by the update thread
+    // without locks. A subscriber that falls behind loses frames (counted by the ring's
+    // overruns()) rather than slowing the exchange loop. Returns nullptr when all
+    // MAX_SUBSCRIBERS slots are taken.
+    std::shared_ptr<TelemetryRing> subscribe(size_t depth = 64);
+
+    // Stop filling ring. Once this returns the update thread no longer touches it.
+    void unsubscribe(const std::shared_ptr<TelemetryRing>& ring);
 
     bool isRFConnected();
 
-private:
-    std::thread m_update_thread;
+    // Exchanges that started after their slot / slots skipped entirely when running
+    // at a fixed update_rate_hz
+    uint64_t overruns() const { return m_scheduler.overruns(); }
+    uint64_t skipped_slots() const { return m_scheduler.skipped(); }
+
+    // Requests that ran out of their action's budget
+    uint64_t timeouts() const { return m_timeouts; }
+
+    // ExchangeData replies that weren't a 200 OK (SOAP faults): never parsed or published
+    uint64_t faults() const { return m_faults; }
+
+    // Setpoints that were overwritten before an exchange could send them
+    uint64_t superseded_commands() const { return m_superseded; }
+
+    // Per-phase latency of successful exchanges since construction (see
+    // phasestats.hpp), readable from any thread while the loop runs
+    const LatencyHistogram& phase_histogram(ExchangePhase phase) const { return m_phase_stats.histogram(phase); }
+    void print_phases(std::ostream& os) const;
+
+    // Stick-to-wire and stick-to-telemetry: from a command's input event
+    // (RFCmd::input_ns, the joystick's kernel timestamp) to its request being sent
+    // (handed to the transport where the backend can't tell) and to the first frame
+    // parsed from its reply. Each command counts once, on its first successful
+    // exchange; sources without input timestamps record nothing.
+    const LatencyHistogram& input_to_sent() const { return m_input_to_sent; }
+    const LatencyHistogram& input_to_parsed() const { return m_input_to_parsed; }
+    void print_input_latency(std::ostream& os) const;
+
+    // Physics-time accounting of every reply: duplicates (the simulator hadn't
+    // stepped), gaps (it stepped more than once), and the simulator step rate against
+    // the exchange rate (see physicsclock.hpp)
+    PhysicsClock::Stats frame_stats() const { return m_physics.stats(); }
+
+    // Exchanges recorded to RFConfig::record_path, and lost because the next file
+    // wasn't ready in time
+    uint64_t recorded() const { return m_recorder.written(); }
+    uint64_t recorder_dropped() const { return m_recorder.dropped(); }
+
+    // The RFConfig::column_log_path writer: frames, blocks and bytes written, frames lost
+    const ColumnLogWriter& column_log() const { return m_column_log; }
+
+protected:
+    // BasicRFInterface connects and starts the update thread
+    RFInterfaceBase(const char* rf_ip, uint16_t rf_port, const RFConfig& config);
+    ~RFInterfaceBase();
+
+    // Stop and join the update thread. Must run before the source is destroyed.
+    void stop_update();
 
-    Joystick m_joystick;
+    // Update-thread bookkeeping around BasicRFInterface::update(). Both return true
+    // when realtime settings should be applied now (straight away, or after the first
+    // jitter window).
+    bool begin_update();
+    bool end_exchange();
+
+    // Pin / prioritise the update thread and lock memory. The input thread belongs
+    // to the source.
+    void apply_realtime();
+
+    // Build the HTTP request for action into the request buffer and return it, or
+    // nullptr if it doesn't fit
+    const char* build_request(const char *action, const char *body, size_t& len);
+
+    // ExchangeData body for input, valid until the next call
+    const char* exchange_body(const struct RFCmd &input);
+
+    // Account for a finished exchange (reply length or negative errno). Returns the
+    // reply, or nullptr on failure.
+    char* finish_request(const char *action, ssize_t n);
+
+    // Whether response is a 200 OK, logging why not
+    bool reply_ok(const char *action, const char *response);
 
-    bool soap_request_start(const char *action, const char *fmt, ...);
-    char *soap_request_end(uint32_t timeout_ms);
-    void exchange_data(const struct RFCmd &input);
     void parse_reply(const char *reply);
-    
+
+    // After a successful exchange that started (command taken) at taken
+    void record_phases(int64_t taken, const ExchangeTimes& times) {
+        m_phase_stats.record(taken, times, m_parsed_ns, monotonic_ns());
+    }
+
+    // After a successful exchange of a command from an input event at input_ns
+    void record_input(int64_t input_ns, const ExchangeTimes& times) {
+        if (input_ns == m_last_input_ns) {
+            return;     // re-sent, already counted
+        }
+        m_last_input_ns = input_ns;
+        m_input_to_sent.record((times.sent ? times.sent : times.start) - input_ns);
+        m_input_to_parsed.record(m_parsed_ns - input_ns);
+    }
+
+    // After a successful exchange, when RFConfig::record_path is set
+    bool recording() const { return m_recorder.is_open(); }
+    void record_flight(int64_t taken, const ExchangeTimes& times);
+
     const char* rf_server_ip;  // Windows machine IP on which RF is running
     uint16_t rf_server_port;   // 18083 or whatever RF uses
-    int sock_fd;
-    char reply_buffer[10000];
 
-    bool m_connected;
+    std::thread m_update_thread;
+    std::atomic<bool> m_running;
+    RateScheduler m_scheduler;
+    RFConfig m_config;
+    std::atomic<bool> m_connected;
+
+    // Last setpoint taken from the source, re-sent until a newer one arrives
+    Setpoint m_command;
+    std::atomic<uint64_t> m_superseded;
+    std::atomic<uint64_t> m_faults;
+
+    // Transports are single threaded: one SOAP request at a time, whichever thread
+    std::mutex m_request_mutex;
+    char reply_buffer[MAX_REPLY_BYTES];
+
+private:
+    void publish_state();
+    void dump_phases();
+
+    // Working copy filled in by parse_reply on the update thread, then published
+    RFState state;
+    Seqlock<StateFrame> m_published;
+    FrameNotifier m_frame_notifier;
+
+    // Subscriber rings. The update thread only reads m_subscribers; the shared_ptrs
+    // that keep the rings alive are managed under m_subscribe_mutex.
+    std::atomic<TelemetryRing*> m_subscribers[MAX_SUBSCRIBERS];
+    std::shared_ptr<TelemetryRing> m_subscriber_refs[MAX_SUBSCRIBERS];
+    std::atomic<bool> m_fanout_busy;
+    std::mutex m_subscribe_mutex;
+
+    ShmTelemetryWriter m_shm;
+    uint64_t m_frame_seq;
+
+    char m_request[4096];
+    char m_body[1024];
+
+    JitterStats m_jitter;
+
+    bool m_rt_pending;
+    int64_t m_last_exchange_ns;
+
+    PhaseStats m_phase_stats;
+    int64_t m_parsed_ns;            // stamp of the last frame
+    PhysicsClock m_physics;
+    FrameKind m_frame_kind;         // of the last frame
+    uint64_t m_record_seq;          // its published seq, 0 if not published
+    FlightRecorder m_recorder;
+    uint64_t m_recorded_exchanges;
+    ColumnLogWriter m_column_log;
+    std::shared_ptr<TelemetryRing> m_column_log_ring;
+    LatencyHistogram m_input_to_sent;
+    LatencyHistogram m_input_to_parsed;
+    int64_t m_last_input_ns;
+    std::thread m_dump_thread;
+    std::atomic<bool> m_dumping;
+
+    std::atomic<uint64_t> m_timeouts;
     double last_time_s = 0;
 };
 
+
+// Transport policies are default constructed, except AutoTransport which follows
+// RFConfig::transport
+template <class T>
+inline T* new_transport(const RFConfig&) { return new T(); }
+
+template <>
+inline AutoTransport* new_transport<AutoTransport>(const RFConfig& config) {
+    return new AutoTransport(config.transport);
+}
+
+
+// RFInterface taking its commands from Source (see commandsource.hpp) and exchanging
+// them over TransportT (see transport.hpp): EpollTransport / UringTransport for a real
+// simulator, LoopbackTransport<Handler> for an in-process one, ReplayTransport for
+// recorded replies. Both are template arguments so the update loop calls them
+// directly. Arguments after config are passed to the Source constructor.
+template <class Source, class TransportT = AutoTransport>
+class BasicRFInterface : public RFInterfaceBase {
+public:
+    template <class... SourceArgs>
+    BasicRFInterface(const char* rf_ip = "127.0.0.1", uint16_t rf_port = 18083,
+                     const RFConfig& config = RFConfig(), SourceArgs&&... source_args)
+        : RFInterfaceBase(rf_ip, rf_port, config),
+          m_transport(new_transport<TransportT>(config)),
+          m_endpoint(-1),
+          m_source(std::forward<SourceArgs>(source_args)...)
+    {
+        start();
+    }
+
+    // Same with a transport set up by the caller (e.g. a loaded ReplayTransport).
+    // Takes ownership of transport.
+    template <class... SourceArgs>
+    BasicRFInterface(TransportT* transport, const char* rf_ip, uint16_t rf_port,
+                     const RFConfig& config = RFConfig(), SourceArgs&&... source_args)
+        : RFInterfaceBase(rf_ip, rf_port, config),
+          m_transport(transport),
+          m_endpoint(-1),
+          m_source(std::forward<SourceArgs>(source_args)...)
+    {
+        start();
+    }
+
+    ~BasicRFInterface() {
+        stop_update();
+        disconnect();
+    }
+
+    // Main update method like the original
+    void update() {
+        if (begin_update()) {
+            go_realtime();
+        }
+
+        while(m_running && m_connected) {
+            // Sleep until the next slot when running at a fixed rate
+            m_scheduler.wait();
+
+            // Take the newest setpoint; anything published in between is superseded.
+            // With nothing new, the previous command is sent again.
+            uint64_t superseded = 0;
+            if (m_source.take(m_command, superseded)) {
+                m_superseded += superseded;
+            }
+
+            exchange_data(m_command.cmd);
+
+            if (end_exchange()) {
+                go_realtime();
+            }
+        }
+    }
+
+    // Control mode switching
+    bool connect() {
+        // Inject the UAV controller interface to take over from the internal RC
+        if (!soap_command("InjectUAVControllerInterface", m_config.timeouts.controller_ms)) {
+            return false;
+        }
+        std::cout << "External control enabled (RealFlight Link active)" << std::endl;
+        m_connected = true;
+        return true;
+    }
+
+    bool disconnect() {
+        // Restore the original controller device (joystick/RC)
+        if (!soap_command("RestoreOriginalControllerDevice", m_config.timeouts.controller_ms)) {
+            return false;
+        }
+        std::cout << "External control disabled (internal RC/joystick active)" << std::endl;
+        m_connected = false;
+        return true;
+    }
+
+    // Aircraft control
+    bool reset_aircraft() {
+        // Reset aircraft position (equivalent to pressing spacebar in RealFlight)
+        if (!soap_command("ResetAircraft", m_config.timeouts.reset_aircraft_ms)) {
+            return false;
+        }
+        std::cout << "Aircraft reset to initial position" << std::endl;
+        return true;
+    }
+
+    Source& source() { return m_source; }
+
+    // Backend in use and its syscall/exchange counters
+    TransportT& transport() { return *m_transport; }
+    const TransportT& transport() const { return *m_transport; }
+
+private:
+    std::unique_ptr<TransportT> m_transport;
+    int m_endpoint;
+    Source m_source;
+
+    void start() {
+        m_endpoint = m_transport->add_endpoint(rf_server_ip, rf_server_port, m_config.prewarm_connections);
+        bool init_ok = (m_endpoint >= 0);
+        std::cout << "[INFO] RFInterface: using " << m_transport->name() << " transport" << std::endl;
+
+        if(init_ok &= connect()) {
+            std::cout << "RFInterface initialized for " << rf_server_ip << ":" << rf_server_port << std::endl;
+        }
+
+        if (init_ok) {
+            m_running = true;
+            m_update_thread = std::thread(&BasicRFInterface::update, this);
+            std::cout << "[SUCCESS] RFInterface Connected Successfully" <<  std::endl;
+        } else {
+            std::cout << "[ERROR] RFInterface Initialization Failed" <<  std::endl;
+        }
+    }
+
+    // Send a request and wait for its reply, which stays in reply_buffer until the
+    // next request: call with m_request_mutex held, and keep holding it while the
+    // reply is used
+    char* soap_request(const char *action, uint32_t timeout_ms, const char *body) {
+        // The budget covers building the request as well as every network phase
+        const Deadline deadline = Deadline::after_ms(timeout_ms);
+
+        size_t len;
+        const char* request = build_request(action, body, len);
+        if (!request) {
+            return finish_request(action, -EMSGSIZE);
+        }
+
+        // Connect, send and receive on a fresh connection (RealFlight allows one
+        // request per connection), all before the deadline
+        ssize_t n = m_transport->exchange(m_endpoint, request, len,
+                                          reply_buffer, sizeof(reply_buffer), deadline);
+        return finish_request(action, n);
+    }
+
+    // Request whose reply only needs to be a 200 OK
+    bool soap_command(const char *action, uint32_t timeout_ms) {
+        std::lock_guard<std::mutex> lock(m_request_mutex);
+        return reply_ok(action, soap_request(action, timeout_ms, ""));
+    }
+
+    void exchange_data(const struct RFCmd &input) {
+        int64_t taken = m_config.phase_timing ? monotonic_ns() : 0;
+        std::lock_guard<std::mutex> lock(m_request_mutex);
+        char* response = soap_request("ExchangeData", m_config.timeouts.exchange_data_ms, exchange_body(input));
+        if (!response) {
+            RF_LOG(LOG_WARN, "RFInterface: no ExchangeData reply, state not updated");
+            return;
+        }
+        // A SOAP fault carries no state: nothing to parse, time or record
+        if (!reply_ok("ExchangeData", response)) {
+            m_faults++;
+            return;
+        }
+
+        parse_reply(response);
+        if (taken) {
+            record_phases(taken, m_transport->last_times());
+        }
+        if (input.input_ns) {
+            record_input(input.input_ns, m_transport->last_times());
+        }
+        if (recording()) {
+            record_flight(taken, m_transport->last_times());
+        }
+    }
+
+    void go_realtime() {
+        apply_realtime();
+        if (!m_config.input_thread.is_default()) {
+            m_source.configureThread(m_config.input_thread);
+        }
+    }
+};
+
+// The original interface: commands from the joystick at /dev/input/event0, transport
+// picked at runtime
+typedef BasicRFInterface<JoystickSource> RFInterface;
+
 } // namespace RF
@@ -0,0 +1,32 @@
+#include <cstdlib>
+#include <new>
+#include <atomic>
+
+#include "alloc_count.hpp"
+
+namespace {
+std::atomic<uint64_t> g_allocs(0);
+thread_local uint64_t t_allocs = 0;
+
+void* counted_alloc(size_t size) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    t_allocs++;
+    void* p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+}
+
+namespace RF {
+uint64_t alloc_count() { return g_allocs.load(std::memory_order_relaxed); }
+uint64_t thread_alloc_count() { return t_allocs; }
+}
+
+void* operator new(size_t size) { return counted_alloc(size); }
+void* operator new[](size_t size) { return counted_alloc(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+
+// Heap allocation counters for the benchmarks. Linking alloc_count.cpp replaces the
+// global operator new/delete with versions that count every allocation.
+namespace RF {
+
+// Allocations by any thread since start
+uint64_t alloc_count();
+
+// Allocations by the calling thread since it started
+uint64_t thread_alloc_count();
+
+} // namespace RF
@@ -0,0 +1,377 @@
+// Microbenchmark of the SOAP codec (soapcodec.hpp): every reply parser, request body
+// serializer and request writer against the corpus in src/bench/corpus, one JSON
+// line per implementation and corpus entry.
+//
+// Usage: rf_codec_bench [--corpus DIR] [--iterations N] [--check]
+//
+//   --corpus      directory with <name>.reply / <name>.golden pairs and controls.golden
+//   --iterations  runs per implementation and entry (default 20000)
+//   --check       only compare against the golden values, no timing
+//
+// Every implementation is checked against the goldens first: a parse must give the
+// exact (bit-identical) value of every RFState field, a body must match byte for byte,
+// and a whole request must match the reference (stringstream) writer's.
+// Any difference is printed to stderr and the exit status is 1, so a faster codec
+// can't silently change results.
+
+#include <dirent.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include "src/soapcodec.hpp"
+#include "alloc_count.hpp"
+
+#ifndef RF_CORPUS_DIR
+#define RF_CORPUS_DIR "src/bench/corpus"
+#endif
+
+using namespace RF;
+
+static const int NUM_FIELDS = sizeof(RFState) / sizeof(double);
+
+struct ReplyCase {
+    std::string name;
+    std::string reply;
+    double expected[NUM_FIELDS];
+};
+
+struct ControlsCase {
+    std::string name;
+    RFCmd cmd;
+    std::string body;
+};
+
+typedef void (*ParseFn)(const char* reply, RFState& state);
+typedef size_t (*WriteFn)(const RFCmd& cmd, char* buf, size_t cap);
+typedef size_t (*RequestFn)(const char* action, const char* body, char* buf, size_t cap);
+
+static size_t write_stream(const RFCmd& cmd, char* buf, size_t cap) {
+    static std::string body;
+    write_controls_stream(cmd, body);
+    if (body.size() >= cap) return cap;
+    memcpy(buf, body.c_str(), body.size() + 1);
+    return body.size();
+}
+
+static size_t request_stream(const char* action, const char* body, char* buf, size_t cap) {
+    static std::string request;
+    write_request_stream(action, body, request);
+    if (request.size() >= cap) return cap;
+    memcpy(buf, request.c_str(), request.size() + 1);
+    return request.size();
+}
+
+static const struct { const char* name; ParseFn fn; } PARSERS[] = {
+    { "search", parse_state_search },
+    { "scan", parse_state_scan },
+};
+
+static const struct { const char* name; WriteFn fn; } WRITERS[] = {
+    { "stream", write_stream },
+    { "snprintf", write_controls },
+};
+
+static const struct { const char* name; RequestFn fn; } REQUESTS[] = {
+    { "stream", request_stream },
+    { "buffer", write_request },
+};
+
+// Requests sent without a body
+static const char* const EMPTY_ACTIONS[] = {
+    "InjectUAVControllerInterface", "ResetAircraft", "RestoreOriginalControllerDevice",
+};
+
+// Name of RFState field i as used in the golden files
+static std::string field_name(int i) {
+    if (i < RF_NUM_CHANNELS) {
+        return "rcin" + std::to_string(i);
+    }
+    const size_t offset = i * sizeof(double);
+    for (size_t f = 0; f < NUM_STATE_FIELDS; f++) {
+        if (STATE_FIELDS[f].offset == offset) return STATE_FIELDS[f].tag;
+    }
+    return "?";
+}
+
+static bool read_file(const std::string& path, std::string& out) {
+    std::ifstream in(path.c_str(), std::ios::binary);
+    if (!in) return false;
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    out = ss.str();
+    return true;
+}
+
+static bool load_golden(const std::string& path, ReplyCase& c) {
+    std::ifstream in(path.c_str());
+    if (!in) {
+        fprintf(stderr, "rf_codec_bench: missing %s\n", path.c_str());
+        return false;
+    }
+    std::vector<bool> seen(NUM_FIELDS, false);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream ls(line);
+        std::string name, value;
+        ls >> name >> value;
+        int i = 0;
+        while (i < NUM_FIELDS && field_name(i) != name) i++;
+        if (i == NUM_FIELDS || value.empty()) {
+            fprintf(stderr, "rf_codec_bench: %s: bad line '%s'\n", path.c_str(), line.c_str());
+            return false;
+        }
+        c.expected[i] = strtod(value.c_str(), nullptr);
+        seen[i] = true;
+    }
+    for (int i = 0; i < NUM_FIELDS; i++) {
+        if (!seen[i]) {
+            fprintf(stderr, "rf_codec_bench: %s: no value for %s\n", path.c_str(), field_name(i).c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool load_replies(const std::string& dir, std::vector<ReplyCase>& cases) {
+    DIR* d = opendir(dir.c_str());
+    if (!d) {
+        fprintf(stderr, "rf_codec_bench: can't open corpus %s\n", dir.c_str());
+        return false;
+    }
+    std::vector<std::string> names;
+    while (struct dirent* e = readdir(d)) {
+        std::string file = e->d_name;
+        if (file.size() > 6 && file.compare(file.size() - 6, 6, ".reply") == 0) {
+            names.push_back(file.substr(0, file.size() - 6));
+        }
+    }
+    closedir(d);
+    std::sort(names.begin(), names.end());
+
+    for (size_t i = 0; i < names.size(); i++) {
+        ReplyCase c;
+        c.name = names[i];
+        if (!read_file(dir + "/" + c.name + ".reply", c.reply) ||
+            !load_golden(dir + "/" + c.name + ".golden", c)) {
+            return false;
+        }
+        cases.push_back(c);
+    }
+    return !cases.empty();
+}
+
+// controls.golden: "cmd <name> throttle aileron elevator rudder flaps gear mask(hex)
+// channels[12]" then "body <text>"
+static bool load_controls(const std::string& path, std::vector<ControlsCase>& cases) {
+    std::ifstream in(path.c_str());
+    if (!in) {
+        fprintf(stderr, "rf_codec_bench: missing %s\n", path.c_str());
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.compare(0, 4, "cmd ") == 0) {
+            ControlsCase c;
+            std::istringstream ls(line.substr(4));
+            std::string mask;
+            ls >> c.name >> c.cmd.throttle >> c.cmd.aileron >> c.cmd.elevator >> c.cmd.rudder
+               >> c.cmd.flaps >> c.cmd.gear >> mask;
+            c.cmd.channel_mask = (uint32_t)strtoul(mask.c_str(), nullptr, 16);
+            for (int i = 0; i < RF_NUM_CHANNELS; i++) {
+                ls >> c.cmd.channels[i];
+            }
+            if (!ls) {
+                fprintf(stderr, "rf_codec_bench: %s: bad line '%s'\n", path.c_str(), line.c_str());
+                return false;
+            }
+            cases.push_back(c);
+        } else if (line.compare(0, 5, "body ") == 0 && !cases.empty()) {
+            cases.back().body = line.substr(5);
+        }
+    }
+    return !cases.empty();
+}
+
+static bool check_parse(const char* impl, ParseFn parse, const ReplyCase& c) {
+    RFState state;
+    parse(c.reply.c_str(), state);
+    const double* got = (const double*)&state;
+    bool ok = true;
+    for (int i = 0; i < NUM_FIELDS; i++) {
+        if (memcmp(&got[i], &c.expected[i], sizeof(double)) != 0) {
+            fprintf(stderr, "rf_codec_bench: parse %s %s: %s = %.17g, golden %.17g\n",
+                    impl, c.name.c_str(), field_name(i).c_str(), got[i], c.expected[i]);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+static bool check_write(const char* impl, WriteFn write, const ControlsCase& c) {
+    char buf[2048];
+    size_t n = write(c.cmd, buf, sizeof(buf));
+    if (n >= sizeof(buf) || c.body != std::string(buf, n)) {
+        fprintf(stderr, "rf_codec_bench: write %s %s:\n  got    %.*s\n  golden %s\n", impl, c.name.c_str(),
+                n < sizeof(buf) ? (int)n : 0, buf, c.body.c_str());
+        return false;
+    }
+    return true;
+}
+
+static bool check_request(const char* impl, RequestFn write, const char* action, const std::string& body,
+                          const std::string& name) {
+    std::string expected;
+    write_request_stream(action, body.c_str(), expected);
+    char buf[4096];
+    size_t n = write(action, body.c_str(), buf, sizeof(buf));
+    if (n >= sizeof(buf) || expected != std::string(buf, n)) {
+        fprintf(stderr, "rf_codec_bench: request %s %s:\n  got    %.*s\n  expect %s\n", impl, name.c_str(),
+                n < sizeof(buf) ? (int)n : 0, buf, expected.c_str());
+        return false;
+    }
+    return true;
+}
+
+static void report(const char* kind, const char* impl, const std::string& name, size_t bytes,
+                   int iterations, int64_t ns, uint64_t allocs, bool ok) {
+    double per = (double)ns / iterations;
+    printf("{\"bench\":\"rf_codec\",\"kind\":\"%s\",\"impl\":\"%s\",\"case\":\"%s\",\"bytes\":%zu,"
+           "\"iterations\":%d,\"ns_per_frame\":%.1f,\"mb_per_s\":%.1f,\"allocs_per_frame\":%.2f,\"golden\":\"%s\"}\n",
+           kind, impl, name.c_str(), bytes, iterations, per, per > 0 ? bytes * 1e3 / per : 0.0,
+           (double)allocs / iterations, ok ? "ok" : "MISMATCH");
+    fflush(stdout);
+}
+
+static void usage() {
+    fprintf(stderr, "usage: rf_codec_bench [--corpus DIR] [--iterations N] [--check]\n");
+}
+
+int main(int argc, char* argv[]) {
+    std::string corpus = RF_CORPUS_DIR;
+    int iterations = 20000;
+    bool timing = true;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--check")) {
+            timing = false;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage();
+            return 1;
+        }
+        const char* arg = argv[i];
+        const char* value = argv[++i];
+        if (!strcmp(arg, "--corpus")) corpus = value;
+        else if (!strcmp(arg, "--iterations")) iterations = atoi(value);
+        else {
+            usage();
+            return 1;
+        }
+    }
+    if (iterations < 1) {
+        usage();
+        return 1;
+    }
+
+    std::vector<ReplyCase> replies;
+    std::vector<ControlsCase> controls;
+    if (!load_replies(corpus, replies) || !load_controls(corpus + "/controls.golden", controls)) {
+        return 1;
+    }
+
+    bool all_ok = true;
+    volatile double sink = 0.0;
+
+    for (size_t p = 0; p < sizeof(PARSERS) / sizeof(PARSERS[0]); p++) {
+        for (size_t c = 0; c < replies.size(); c++) {
+            bool ok = check_parse(PARSERS[p].name, PARSERS[p].fn, replies[c]);
+            all_ok &= ok;
+            if (!timing) continue;
+
+            const char* reply = replies[c].reply.c_str();
+            RFState state;
+            uint64_t allocs = thread_alloc_count();
+            int64_t start = monotonic_ns();
+            for (int i = 0; i < iterations; i++) {
+                PARSERS[p].fn(reply, state);
+                sink = sink + state.m_currentPhysicsTime_SEC;
+            }
+            int64_t ns = monotonic_ns() - start;
+            allocs = thread_alloc_count() - allocs;
+            report("parse", PARSERS[p].name, replies[c].name, replies[c].reply.size(), iterations, ns, allocs, ok);
+        }
+    }
+
+    for (size_t w = 0; w < sizeof(WRITERS) / sizeof(WRITERS[0]); w++) {
+        for (size_t c = 0; c < controls.size(); c++) {
+            bool ok = check_write(WRITERS[w].name, WRITERS[w].fn, controls[c]);
+            all_ok &= ok;
+            if (!timing) continue;
+
+            char buf[2048];
+            size_t bytes = 0;
+            uint64_t allocs = thread_alloc_count();
+            int64_t start = monotonic_ns();
+            for (int i = 0; i < iterations; i++) {
+                bytes = WRITERS[w].fn(controls[c].cmd, buf, sizeof(buf));
+                sink = sink + buf[bytes / 2];
+            }
+            int64_t ns = monotonic_ns() - start;
+            allocs = thread_alloc_count() - allocs;
+            report("write", WRITERS[w].name, controls[c].name, bytes, iterations, ns, allocs, ok);
+        }
+    }
+
+    // ExchangeData around every body, then the body-less actions
+    std::vector<std::pair<std::string, std::string> > requests;      // action, body
+    std::vector<std::string> request_names;
+    for (size_t c = 0; c < controls.size(); c++) {
+        requests.push_back(std::make_pair(std::string("ExchangeData"), controls[c].body));
+        request_names.push_back(controls[c].name);
+    }
+    for (size_t a = 0; a < sizeof(EMPTY_ACTIONS) / sizeof(EMPTY_ACTIONS[0]); a++) {
+        requests.push_back(std::make_pair(std::string(EMPTY_ACTIONS[a]), std::string()));
+        request_names.push_back(EMPTY_ACTIONS[a]);
+    }
+
+    for (size_t r = 0; r < sizeof(REQUESTS) / sizeof(REQUESTS[0]); r++) {
+        for (size_t c = 0; c < requests.size(); c++) {
+            const char* action = requests[c].first.c_str();
+            const char* body = requests[c].second.c_str();
+            bool ok = check_request(REQUESTS[r].name, REQUESTS[r].fn, action, requests[c].second, request_names[c]);
+            all_ok &= ok;
+            if (!timing) continue;
+
+            char buf[4096];
+            size_t bytes = 0;
+            uint64_t allocs = thread_alloc_count();
+            int64_t start = monotonic_ns();
+            for (int i = 0; i < iterations; i++) {
+                bytes = REQUESTS[r].fn(action, body, buf, sizeof(buf));
+                sink = sink + buf[bytes / 2];
+            }
+            int64_t ns = monotonic_ns() - start;
+            allocs = thread_alloc_count() - allocs;
+            report("request", REQUESTS[r].name, request_names[c], bytes, iterations, ns, allocs, ok);
+        }
+    }
+
+    if (!all_ok) {
+        fprintf(stderr, "rf_codec_bench: golden check FAILED\n");
+        return 1;
+    }
+    if (!timing) {
+        printf("{\"bench\":\"rf_codec\",\"golden\":\"ok\",\"replies\":%zu,\"controls\":%zu,\"requests\":%zu}\n",
+               replies.size(), controls.size(), requests.size());
+    }
+    return 0;
+}
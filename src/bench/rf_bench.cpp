@@ -0,0 +1,433 @@
+// End-to-end exchange benchmark: drives BasicRFInterface against the mock simulator
+// for a fixed time and prints one JSON line per configuration.
+//
+// Usage: rf_bench [--duration S] [--transport epoll|uring|loopback] [--pool N[,N...]]
+//                 [--rate HZ[,HZ...]] [--latency-us N] [--jitter-us N] [--port N]
+//                 [--step S] [--physics-hz N] [--no-phases] [--assert-no-alloc]
+//                 [--record PREFIX] [--record-mb N] [--column-log PATH]
+//
+//   --pool     pre-opened connections (RFConfig::prewarm_connections)
+//   --rate     RFConfig::update_rate_hz, 0 = as fast as possible
+//   --step     mock physics step per exchange (default 0.0025); 0 steps with the wall
+//              clock at --physics-hz (default 400), so faster exchanges see duplicates
+//   --port     use an rf_mock already listening there instead of an in-process one
+//   --no-phases  turn off RFConfig::phase_timing (to measure what it costs)
+//   --assert-no-alloc  exit with status 1 if the update thread allocated at all
+//              once warmed up: the steady-state exchange loop must not touch the heap
+//   --record   record every exchange to PREFIX.NNNN.rfrec files of --record-mb MB
+//              (RFConfig::record_path, default 64), rewritten for every configuration
+//   --column-log  log every frame to the columnar log PATH (RFConfig::column_log_path),
+//              rewritten for every configuration, then read it back and check every
+//              frame the bench also received through a subscriber ring bit for bit;
+//              a mismatch or a log that doesn't decode exits with status 1
+//
+// take_to_parse is from the start of an iteration (taking the command) to the reply
+// being parsed (StateFrame::stamp_ns), i.e. request building + exchange + parsing;
+// publishing the frame comes after and is in the "publish" phase. CPU time and
+// allocations are those of the update thread.
+
+#include <ctime>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <sstream>
+#include <sys/stat.h>
+
+#include "src/RFInterface.hpp"
+#include "src/columnlog.hpp"
+#include "src/mock/mocksim.hpp"
+#include "src/mock/mockserver.hpp"
+#include "alloc_count.hpp"
+
+using namespace RF;
+
+static const size_t MAX_SAMPLES = 4000000;
+
+static int64_t thread_cpu_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static double percentile(const std::vector<int64_t>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    size_t idx = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[idx] / 1000.0;
+}
+
+// Command source that also measures. Every take() starts an iteration; the frame
+// the previous iteration published (or not) gives its take-to-parse time.
+class BenchSource {
+public:
+    BenchSource()
+        : m_iface(nullptr),
+          m_start(false),
+          m_stop(false),
+          m_done(false),
+          m_measuring(false),
+          m_seq(0),
+          m_last_frame(0),
+          m_take_ns(0),
+          m_errors(0)
+    {
+        m_latencies.reserve(MAX_SAMPLES);
+    }
+
+    void attach(const RFInterfaceBase* iface) { m_iface = iface; }
+
+    void begin() { m_start = true; }
+    void end() { m_stop = true; }
+    bool done() const { return m_done; }
+
+    bool take(Setpoint& out, uint64_t& superseded) {
+        superseded = 0;
+        int64_t now = monotonic_ns();
+
+        if (m_measuring) {
+            StateFrame frame = m_iface->get_state();
+            if (frame.seq != m_last_frame) {
+                if (m_latencies.size() < MAX_SAMPLES) {
+                    m_latencies.push_back(frame.stamp_ns - m_take_ns);
+                }
+                m_last_frame = frame.seq;
+            } else {
+                m_errors++;
+            }
+            if (m_stop) {
+                m_end_ns = now;
+                m_end_cpu_ns = thread_cpu_ns();
+                m_end_allocs = thread_alloc_count();
+                m_measuring = false;
+                m_done = true;
+            }
+        } else if (m_start && !m_done && m_iface) {
+            m_start_ns = now;
+            m_start_cpu_ns = thread_cpu_ns();
+            m_start_allocs = thread_alloc_count();
+            m_last_frame = m_iface->get_state().seq;
+            m_measuring = true;
+        }
+
+        // Keep the sticks moving so every request is different
+        m_seq++;
+        out.cmd = neutral_cmd();
+        out.cmd.throttle = 0.5 + 0.5 * sin(m_seq * 0.001);
+        out.cmd.aileron = 0.5 + 0.2 * sin(m_seq * 0.01);
+        out.stamp_ns = now;
+        out.seq = m_seq;
+        m_take_ns = monotonic_ns();
+        return true;
+    }
+
+    bool configureThread(const ThreadConfig&) { return false; }
+
+    // Valid once done()
+    std::vector<int64_t> m_latencies;
+    uint64_t errors() const { return m_errors; }
+    double seconds() const { return (m_end_ns - m_start_ns) / 1e9; }
+    int64_t cpu_ns() const { return m_end_cpu_ns - m_start_cpu_ns; }
+    uint64_t allocs() const { return m_end_allocs - m_start_allocs; }
+
+private:
+    const RFInterfaceBase* m_iface;
+    std::atomic<bool> m_start;
+    std::atomic<bool> m_stop;
+    std::atomic<bool> m_done;
+    bool m_measuring;
+    uint64_t m_seq;
+    uint64_t m_last_frame;
+    int64_t m_take_ns;
+    uint64_t m_errors;
+    int64_t m_start_ns, m_end_ns;
+    int64_t m_start_cpu_ns, m_end_cpu_ns;
+    uint64_t m_start_allocs, m_end_allocs;
+};
+
+struct BenchOptions {
+    double duration_s;
+    std::string transport;
+    uint16_t port;          // 0: in-process mock
+    bool phases;
+    bool assert_no_alloc;
+    const char* record_path;
+    uint32_t record_mb;
+    const char* column_log_path;
+    MockConfig mock;
+};
+
+// Sleep for ns, meanwhile moving whatever arrives on ring (if any) into frames
+static void sleep_draining(int64_t ns, TelemetryRing* ring, std::vector<StateFrame>& frames) {
+    if (!ring) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(ns));
+        return;
+    }
+    int64_t until = monotonic_ns() + ns;
+    StateFrame frame;
+    do {
+        while (ring->pop(frame)) {
+            frames.push_back(frame);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    } while (monotonic_ns() < until);
+}
+
+// Read the column log at path back and compare it with the frames received live:
+// every one of those that is in the log must decode to the same bits. Prints one
+// JSON line; false on a mismatch or a log that doesn't decode.
+static bool check_column_log(const char* path, const std::vector<StateFrame>& received) {
+    ColumnLogReader reader;
+    if (!reader.open(path)) {
+        fprintf(stderr, "rf_bench: can't read back the column log %s\n", path);
+        return false;
+    }
+
+    size_t next = 0;        // received is in seq order
+    uint64_t logged = 0, blocks = 0, checked = 0, mismatches = 0, gaps = 0, last_seq = 0;
+    bool decoded = true;
+    ColumnBlockInfo block;
+    std::vector<StateFrame> frames;
+    while (reader.next_block(block)) {
+        if (!reader.read_frames(frames)) {
+            decoded = false;
+            break;
+        }
+        blocks++;
+        for (size_t i = 0; i < frames.size(); i++) {
+            const StateFrame& f = frames[i];
+            if (last_seq && f.seq != last_seq + 1) gaps++;
+            last_seq = f.seq;
+            while (next < received.size() && received[next].seq < f.seq) next++;
+            if (next < received.size() && received[next].seq == f.seq) {
+                checked++;
+                if (memcmp(&received[next], &f, sizeof(f)) != 0) mismatches++;
+            }
+        }
+        logged += frames.size();
+    }
+    struct stat st;
+    double bytes = (stat(path, &st) == 0) ? (double)st.st_size : 0.0;
+
+    printf("{\"bench\":\"column_log\",\"frames\":%llu,\"blocks\":%llu,\"bytes_per_frame\":%.1f,"
+           "\"seq_gaps\":%llu,\"received\":%zu,\"checked\":%llu,\"mismatches\":%llu,\"decoded\":%s}\n",
+           (unsigned long long)logged, (unsigned long long)blocks, logged ? bytes / logged : 0.0,
+           (unsigned long long)gaps, received.size(), (unsigned long long)checked,
+           (unsigned long long)mismatches, decoded ? "true" : "false");
+    fflush(stdout);
+    if (!decoded || mismatches || checked == 0) {
+        fprintf(stderr, "rf_bench: column log %s failed the round trip\n", path);
+        return false;
+    }
+    return true;
+}
+
+// One configuration. With a column log, also subscribes ring and fills received from it.
+template <class TransportT>
+static int measure(const BenchOptions& opt, TransportT* transport, uint16_t port, size_t pool, double rate_hz,
+                   std::shared_ptr<TelemetryRing>& ring, std::vector<StateFrame>& received) {
+    RFConfig config;
+    config.prewarm_connections = pool;
+    config.update_rate_hz = rate_hz;
+    config.phase_timing = opt.phases;
+    config.record_path = opt.record_path;
+    config.record_file_mb = opt.record_mb;
+    config.column_log_path = opt.column_log_path;
+
+    int64_t wall_start = monotonic_ns();
+    BasicRFInterface<BenchSource, TransportT> iface(transport, "127.0.0.1", port, config);
+    if (!iface.isRFConnected()) {
+        fprintf(stderr, "rf_bench: could not connect to the mock on port %u\n", port);
+        return 1;
+    }
+    BenchSource& source = iface.source();
+    source.attach(&iface);
+
+    // With a column log, the frames to check it against
+    if (opt.column_log_path) {
+        ring = iface.subscribe(1 << 14);
+    }
+
+    // Warm up (connections, caches, page faults) before measuring
+    sleep_draining(200000000LL, ring.get(), received);
+    uint64_t process_allocs = alloc_count();
+    source.begin();
+    sleep_draining((int64_t)(opt.duration_s * 1e9), ring.get(), received);
+    source.end();
+    while (!source.done() && iface.isRFConnected() && monotonic_ns() - wall_start < 60000000000LL) {
+        sleep_draining(1000000, ring.get(), received);
+    }
+    process_allocs = alloc_count() - process_allocs;
+    if (!source.done()) {
+        fprintf(stderr, "rf_bench: update loop stopped before the run finished\n");
+        return 1;
+    }
+
+    std::vector<int64_t>& lat = source.m_latencies;
+    std::sort(lat.begin(), lat.end());
+    double n = lat.empty() ? 1.0 : (double)lat.size();
+
+    printf("{\"bench\":\"rf_exchange\",\"transport\":\"%s\",\"pool\":%zu,\"rate_hz\":%.1f,"
+           "\"latency_us\":%u,\"jitter_us\":%u,\"seconds\":%.3f,\"exchanges\":%zu,\"errors\":%llu,"
+           "\"exchanges_per_s\":%.1f,\"take_to_parse\":{\"p50_us\":%.3f,\"p99_us\":%.3f,\"p999_us\":%.3f,\"max_us\":%.3f},"
+           "\"cpu_us_per_exchange\":%.3f,\"allocs_per_exchange\":%.2f,\"process_allocs_per_exchange\":%.2f,"
+           "\"timeouts\":%llu,\"faults\":%llu,\"overruns\":%llu,\"syscalls_per_exchange\":%.2f,\"phases\":",
+           opt.transport.c_str(), pool, rate_hz, opt.mock.latency_us, opt.mock.jitter_us,
+           source.seconds(), lat.size(), (unsigned long long)source.errors(),
+           lat.size() / source.seconds(),
+           percentile(lat, 50), percentile(lat, 99), percentile(lat, 99.9),
+           lat.empty() ? 0.0 : lat.back() / 1000.0,
+           source.cpu_ns() / 1000.0 / n, source.allocs() / n, process_allocs / n,
+           (unsigned long long)iface.timeouts(), (unsigned long long)iface.faults(),
+           (unsigned long long)iface.overruns(),
+           iface.transport().exchanges() ? (double)iface.transport().syscalls() / iface.transport().exchanges() : 0.0);
+    fflush(stdout);
+    std::ostringstream phases;
+    if (opt.phases) {
+        iface.print_phases(phases);
+    } else {
+        phases << "null";
+    }
+    std::string phases_json = phases.str();
+    while (!phases_json.empty() && phases_json[phases_json.size() - 1] == '\n') {
+        phases_json.resize(phases_json.size() - 1);
+    }
+    std::ostringstream frames;
+    PhysicsClock::print_json(frames, iface.frame_stats());
+    printf("%s,\"frames\":%s,\"recorded\":%llu,\"record_dropped\":%llu}\n", phases_json.c_str(), frames.str().c_str(),
+           (unsigned long long)iface.recorded(), (unsigned long long)iface.recorder_dropped());
+    fflush(stdout);
+
+    if (opt.assert_no_alloc && source.allocs() != 0) {
+        fprintf(stderr, "rf_bench: update thread allocated %llu times in %zu exchanges (%s, pool %zu, rate %.1f)\n",
+                (unsigned long long)source.allocs(), lat.size(), opt.transport.c_str(), pool, rate_hz);
+        return 1;
+    }
+    return 0;
+}
+
+template <class TransportT>
+static int run(const BenchOptions& opt, TransportT* transport, uint16_t port, size_t pool, double rate_hz) {
+    std::shared_ptr<TelemetryRing> ring;
+    std::vector<StateFrame> received;
+    int status = measure(opt, transport, port, pool, rate_hz, ring, received);
+
+    // The interface is gone: the update thread has stopped and the log is complete
+    if (status == 0 && opt.column_log_path) {
+        sleep_draining(0, ring.get(), received);
+        if (!check_column_log(opt.column_log_path, received)) {
+            status = 1;
+        }
+    }
+    return status;
+}
+
+static std::vector<double> parse_list(const char* arg) {
+    std::vector<double> values;
+    for (const char* p = arg; *p; ) {
+        char* end;
+        values.push_back(strtod(p, &end));
+        if (end == p) break;
+        p = (*end == ',') ? end + 1 : end;
+    }
+    return values;
+}
+
+static void usage() {
+    fprintf(stderr, "usage: rf_bench [--duration S] [--transport epoll|uring|loopback] [--pool N[,N...]]\n"
+                    "                [--rate HZ[,HZ...]] [--latency-us N] [--jitter-us N] [--port N]\n"
+                    "                [--step S] [--physics-hz N] [--no-phases] [--assert-no-alloc]\n"
+                    "                [--record PREFIX] [--record-mb N] [--column-log PATH]\n");
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions opt;
+    opt.duration_s = 2.0;
+    opt.transport = "epoll";
+    opt.port = 0;
+    opt.phases = true;
+    opt.assert_no_alloc = false;
+    opt.record_path = nullptr;
+    opt.record_mb = 64;
+    opt.column_log_path = nullptr;
+    opt.mock.step_s = 0.0025;
+    std::vector<double> pools(1, 3.0);
+    std::vector<double> rates(1, 0.0);
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--no-phases")) {
+            opt.phases = false;
+            continue;
+        }
+        if (!strcmp(argv[i], "--assert-no-alloc")) {
+            opt.assert_no_alloc = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage();
+            return 1;
+        }
+        const char* arg = argv[i];
+        const char* value = argv[++i];
+        if (!strcmp(arg, "--duration")) opt.duration_s = atof(value);
+        else if (!strcmp(arg, "--transport")) opt.transport = value;
+        else if (!strcmp(arg, "--pool")) pools = parse_list(value);
+        else if (!strcmp(arg, "--rate")) rates = parse_list(value);
+        else if (!strcmp(arg, "--latency-us")) opt.mock.latency_us = strtoul(value, nullptr, 10);
+        else if (!strcmp(arg, "--jitter-us")) opt.mock.jitter_us = strtoul(value, nullptr, 10);
+        else if (!strcmp(arg, "--port")) opt.port = (uint16_t)atoi(value);
+        else if (!strcmp(arg, "--step")) opt.mock.step_s = atof(value);
+        else if (!strcmp(arg, "--physics-hz")) opt.mock.physics_hz = atof(value);
+        else if (!strcmp(arg, "--record")) opt.record_path = value;
+        else if (!strcmp(arg, "--record-mb")) opt.record_mb = strtoul(value, nullptr, 10);
+        else if (!strcmp(arg, "--column-log")) opt.column_log_path = value;
+        else {
+            usage();
+            return 1;
+        }
+    }
+    if (opt.transport != "epoll" && opt.transport != "uring" && opt.transport != "loopback") {
+        usage();
+        return 1;
+    }
+    if (opt.transport == "uring" && !UringTransport::supported()) {
+        fprintf(stderr, "rf_bench: io_uring is not available here\n");
+        return 1;
+    }
+
+    // Interface chatter goes to stdout; keep stdout for the JSON lines
+    std::cout.rdbuf(std::cerr.rdbuf());
+
+    MockSim sim(opt.mock);
+    MockServer server(sim);
+    uint16_t port = opt.port;
+    if (port == 0 && opt.transport != "loopback") {
+        if (!server.listen("127.0.0.1", 0) || !server.start()) {
+            return 1;
+        }
+        port = server.port();
+    }
+
+    int status = 0;
+    for (size_t p = 0; p < pools.size(); p++) {
+        for (size_t r = 0; r < rates.size(); r++) {
+            size_t pool = (size_t)pools[p];
+            if (opt.transport == "epoll") {
+                status |= run(opt, new EpollTransport(), port, pool, rates[r]);
+            } else if (opt.transport == "uring") {
+                status |= run(opt, new UringTransport(), port, pool, rates[r]);
+            } else {
+                status |= run(opt, new LoopbackTransport<MockSim>(opt.mock), port, pool, rates[r]);
+            }
+        }
+    }
+
+    server.stop();
+    return status;
+}
@@ -0,0 +1,119 @@
+// Cross-process latency of shared-memory telemetry: a writer process publishes
+// frames at a fixed rate and a forked reader process measures publish -> seen time.
+//
+// Usage: rf_shm_bench [frames] [rate_hz] [--spin]
+//   --spin   reader busy-polls instead of waiting on the futex
+
+#include <unistd.h>
+#include <sys/wait.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+#include "src/shmtelemetry.hpp"
+#include "src/ratescheduler.hpp"
+
+using namespace RF;
+
+static const char* SHM_NAME = "/rf_shm_bench";
+
+static double percentile(const std::vector<int64_t>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    size_t idx = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[idx] / 1000.0;
+}
+
+static int run_reader(uint64_t frames, bool spin) {
+    ShmTelemetryReader reader;
+    while (!reader.attach(SHM_NAME)) {
+        usleep(1000);
+    }
+
+    std::vector<int64_t> latencies;
+    latencies.reserve(frames);
+    uint64_t seq = 0;
+    uint64_t missed = 0;
+    StateFrame frame;
+
+    while (seq < frames) {
+        uint64_t newest;
+        if (spin) {
+            newest = reader.latest(frame);
+            if (newest <= seq) continue;
+        } else {
+            newest = reader.wait_for_frame(seq, 1000);
+            if (newest <= seq) break;       // writer went away
+            reader.latest(frame);
+        }
+        int64_t now = monotonic_ns();
+        latencies.push_back(now - frame.stamp_ns);
+        missed += frame.seq - seq - 1;
+        seq = frame.seq;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    printf("{\"bench\":\"shm_latency\",\"mode\":\"%s\",\"frames\":%zu,\"missed\":%llu,"
+           "\"p50_us\":%.3f,\"p99_us\":%.3f,\"p999_us\":%.3f,\"max_us\":%.3f}\n",
+           spin ? "spin" : "futex", latencies.size(), (unsigned long long)missed,
+           percentile(latencies, 50), percentile(latencies, 99), percentile(latencies, 99.9),
+           latencies.empty() ? 0.0 : latencies.back() / 1000.0);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t frames = 100000;
+    double rate_hz = 1000.0;
+    bool spin = false;
+
+    int positional = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--spin") == 0) {
+            spin = true;
+        } else if (positional == 0) {
+            frames = strtoull(argv[i], nullptr, 10);
+            positional++;
+        } else {
+            rate_hz = atof(argv[i]);
+        }
+    }
+
+    ShmTelemetryWriter writer;
+    if (!writer.open(SHM_NAME, 256)) {
+        return 1;
+    }
+
+    pid_t child = fork();
+    if (child < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (child == 0) {
+        // _exit: returning from main would run the destructor of the child's copy of
+        // writer, which unlinks and unmaps the segment the parent still publishes to
+        int rc = run_reader(frames, spin);
+        fflush(stdout);
+        _exit(rc);
+    }
+
+    // Give the reader time to attach before the first frame
+    usleep(100000);
+
+    StateFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    RateScheduler scheduler(rate_hz);
+    scheduler.start();
+    for (uint64_t seq = 1; seq <= frames; seq++) {
+        scheduler.wait();
+        frame.seq = seq;
+        frame.state.m_currentPhysicsTime_SEC = seq * 0.001;
+        frame.stamp_ns = monotonic_ns();
+        writer.publish(frame);
+    }
+
+    int status = 0;
+    waitpid(child, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
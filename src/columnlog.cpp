@@ -0,0 +1,661 @@
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <ctime>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <chrono>
+
+#include "columnlog.hpp"
+#include "soapcodec.hpp"
+#include "rfcmd.hpp"
+#include "logger.hpp"
+
+namespace RF {
+
+static const char MAGIC[8] = { 'R', 'F', 'C', 'O', 'L', 'L', 'O', 'G' };
+
+namespace {
+
+// Column table, and where each column's value lives in a StateFrame
+struct ColumnTable {
+    static const size_t MAX_COLUMNS = 2 + RF_NUM_CHANNELS + 64;
+
+    ColumnInfo columns[MAX_COLUMNS];
+    size_t offsets[MAX_COLUMNS];
+    uint32_t count;
+
+    void add(const char* name, size_t offset, ColumnType type) {
+        ColumnInfo& c = columns[count];
+        memset(&c, 0, sizeof(c));
+        snprintf(c.name, sizeof(c.name), "%s", name);
+        c.type = type;
+        offsets[count++] = offset;
+    }
+
+    ColumnTable() : count(0) {
+        add("seq", offsetof(StateFrame, seq), COLUMN_DELTA);
+        add("stamp_ns", offsetof(StateFrame, stamp_ns), COLUMN_DELTA);
+
+        size_t state = offsetof(StateFrame, state);
+        for (int i = 0; i < RF_NUM_CHANNELS; i++) {
+            char name[16];
+            snprintf(name, sizeof(name), "rcin%d", i);
+            add(name, state + offsetof(RFState, rcin) + i * sizeof(double), COLUMN_XOR);
+        }
+        for (size_t i = 0; i < NUM_STATE_FIELDS; i++) {
+            add(STATE_FIELDS[i].tag, state + STATE_FIELDS[i].offset,
+                is_flag(STATE_FIELDS[i].offset) ? COLUMN_FLAG : COLUMN_XOR);
+        }
+    }
+
+    // The reply's true/false fields
+    static bool is_flag(size_t offset) {
+        return offset == offsetof(RFState, m_isLocked) ||
+               offset == offsetof(RFState, m_hasLostComponents) ||
+               offset == offsetof(RFState, m_anEngineIsRunning) ||
+               offset == offsetof(RFState, m_isTouchingGround) ||
+               offset == offsetof(RFState, m_flightAxisControllerIsActive) ||
+               offset == offsetof(RFState, m_resetButtonHasBeenPressed);
+    }
+};
+
+const ColumnTable& column_table() {
+    static const ColumnTable table;
+    return table;
+}
+
+inline uint64_t frame_bits(const StateFrame& frame, size_t offset) {
+    uint64_t bits;
+    memcpy(&bits, (const char*)&frame + offset, sizeof(bits));
+    return bits;
+}
+
+inline double bits_double(uint64_t bits) {
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static const uint64_t ZERO_BITS = 0;
+static const uint64_t ONE_BITS = 0x3ff0000000000000ULL;    // 1.0
+
+
+// MSB-first bit stream appended to a byte vector
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : m_out(out), m_cur(0), m_used(0) {}
+
+    // The low n bits of value, n in [1, 64]
+    void write(uint64_t value, unsigned n) {
+        while (n > 0) {
+            unsigned room = 8 - m_used;
+            unsigned take = n < room ? n : room;
+            uint8_t chunk = (uint8_t)((value >> (n - take)) & ((1u << take) - 1));
+            m_cur |= (uint8_t)(chunk << (room - take));
+            m_used += take;
+            n -= take;
+            if (m_used == 8) {
+                m_out.push_back(m_cur);
+                m_cur = 0;
+                m_used = 0;
+            }
+        }
+    }
+
+    void flush() {
+        if (m_used) {
+            m_out.push_back(m_cur);
+            m_cur = 0;
+            m_used = 0;
+        }
+    }
+
+private:
+    std::vector<uint8_t>& m_out;
+    uint8_t m_cur;
+    unsigned m_used;
+};
+
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t len) : m_data(data), m_len(len), m_pos(0), m_overrun(false) {}
+
+    uint64_t read(unsigned n) {
+        uint64_t value = 0;
+        while (n > 0) {
+            size_t byte = m_pos >> 3;
+            if (byte >= m_len) {
+                m_overrun = true;
+                return 0;
+            }
+            unsigned used = m_pos & 7;
+            unsigned room = 8 - used;
+            unsigned take = n < room ? n : room;
+            uint64_t chunk = (m_data[byte] >> (room - take)) & ((1u << take) - 1);
+            value = (value << take) | chunk;
+            m_pos += take;
+            n -= take;
+        }
+        return value;
+    }
+
+    bool overrun() const { return m_overrun; }
+
+private:
+    const uint8_t* m_data;
+    size_t m_len;
+    size_t m_pos;       // in bits
+    bool m_overrun;
+};
+
+
+// Gorilla XOR: '0' same value; '10' + the XOR's meaningful bits in the previous
+// window; '11' + 5 bits leading zeros + 6 bits length - 1 + the meaningful bits
+void encode_xor(const StateFrame* frames, size_t n, size_t offset, BitWriter& w) {
+    uint64_t prev = frame_bits(frames[0], offset);
+    w.write(prev, 64);
+    unsigned lead = 65, trail = 0;      // no window yet
+    for (size_t i = 1; i < n; i++) {
+        uint64_t value = frame_bits(frames[i], offset);
+        uint64_t x = value ^ prev;
+        prev = value;
+        if (x == 0) {
+            w.write(0, 1);
+            continue;
+        }
+        unsigned lz = __builtin_clzll(x);
+        unsigned tz = __builtin_ctzll(x);
+        if (lz > 31) lz = 31;
+        if (lead <= 64 && lz >= lead && tz >= trail) {
+            w.write(2, 2);
+            w.write(x >> trail, 64 - lead - trail);
+        } else {
+            unsigned meaningful = 64 - lz - tz;
+            w.write(3, 2);
+            w.write(lz, 5);
+            w.write(meaningful - 1, 6);
+            w.write(x >> tz, meaningful);
+            lead = lz;
+            trail = tz;
+        }
+    }
+}
+
+bool decode_xor(BitReader& r, size_t n, uint64_t* out) {
+    uint64_t prev = r.read(64);
+    out[0] = prev;
+    unsigned lead = 0, trail = 0;
+    for (size_t i = 1; i < n; i++) {
+        if (r.read(1) != 0) {
+            if (r.read(1) != 0) {
+                lead = (unsigned)r.read(5);
+                unsigned meaningful = (unsigned)r.read(6) + 1;
+                if (lead + meaningful > 64) return false;
+                trail = 64 - lead - meaningful;
+            }
+            prev ^= r.read(64 - lead - trail) << trail;
+        }
+        out[i] = prev;
+    }
+    return !r.overrun();
+}
+
+
+// Delta of delta, zigzagged: '0', or '10' / '110' / '1110' + 8 / 16 / 32 bits, or
+// '1111' + 64 bits
+void encode_delta(const StateFrame* frames, size_t n, size_t offset, BitWriter& w) {
+    uint64_t prev = frame_bits(frames[0], offset);
+    w.write(prev, 64);
+    uint64_t prev_delta = 0;
+    for (size_t i = 1; i < n; i++) {
+        uint64_t value = frame_bits(frames[i], offset);
+        uint64_t delta = value - prev;
+        int64_t dod = (int64_t)(delta - prev_delta);
+        uint64_t zz = ((uint64_t)dod << 1) ^ (uint64_t)(dod >> 63);
+        prev = value;
+        prev_delta = delta;
+        if (zz == 0) {
+            w.write(0, 1);
+        } else if (zz < (1ULL << 8)) {
+            w.write(2, 2);
+            w.write(zz, 8);
+        } else if (zz < (1ULL << 16)) {
+            w.write(6, 3);
+            w.write(zz, 16);
+        } else if (zz < (1ULL << 32)) {
+            w.write(14, 4);
+            w.write(zz, 32);
+        } else {
+            w.write(15, 4);
+            w.write(zz, 64);
+        }
+    }
+}
+
+bool decode_delta(BitReader& r, size_t n, uint64_t* out) {
+    uint64_t prev = r.read(64);
+    out[0] = prev;
+    uint64_t prev_delta = 0;
+    static const unsigned BITS[] = { 8, 16, 32, 64 };
+    for (size_t i = 1; i < n; i++) {
+        uint64_t zz = 0;
+        unsigned ones = 0;
+        while (ones < 4 && r.read(1) != 0) {
+            ones++;
+        }
+        if (ones > 0) {
+            zz = r.read(BITS[ones - 1]);
+        }
+        uint64_t dod = (zz >> 1) ^ (0 - (zz & 1));
+        prev_delta += dod;
+        prev += prev_delta;
+        out[i] = prev;
+        if (r.overrun()) return false;
+    }
+    return !r.overrun();
+}
+
+
+// Flags: '0' unchanged, '10' flipped between 0 and 1, '11' + any other value raw
+void encode_flag(const StateFrame* frames, size_t n, size_t offset, BitWriter& w) {
+    uint64_t prev = frame_bits(frames[0], offset);
+    w.write(prev, 64);
+    for (size_t i = 1; i < n; i++) {
+        uint64_t value = frame_bits(frames[i], offset);
+        if (value == prev) {
+            w.write(0, 1);
+        } else if ((prev == ZERO_BITS && value == ONE_BITS) || (prev == ONE_BITS && value == ZERO_BITS)) {
+            w.write(2, 2);
+        } else {
+            w.write(3, 2);
+            w.write(value, 64);
+        }
+        prev = value;
+    }
+}
+
+bool decode_flag(BitReader& r, size_t n, uint64_t* out) {
+    uint64_t prev = r.read(64);
+    out[0] = prev;
+    for (size_t i = 1; i < n; i++) {
+        if (r.read(1) != 0) {
+            if (r.read(1) == 0) {
+                prev = (prev == ONE_BITS) ? ZERO_BITS : ONE_BITS;
+            } else {
+                prev = r.read(64);
+            }
+        }
+        out[i] = prev;
+    }
+    return !r.overrun();
+}
+
+bool decode(const uint8_t* data, size_t len, uint32_t type, size_t n, uint64_t* out) {
+    if (n == 0) return true;
+    BitReader r(data, len);
+    switch (type) {
+    case COLUMN_XOR:    return decode_xor(r, n, out);
+    case COLUMN_DELTA:  return decode_delta(r, n, out);
+    case COLUMN_FLAG:   return decode_flag(r, n, out);
+    default:            return false;
+    }
+}
+
+bool write_all(int fd, const uint8_t* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+} // namespace
+
+const ColumnInfo* column_log_columns(uint32_t& count) {
+    const ColumnTable& table = column_table();
+    count = table.count;
+    return table.columns;
+}
+
+
+void encode_column_block(const StateFrame* frames, size_t n, std::vector<uint8_t>& out) {
+    const ColumnTable& table = column_table();
+    size_t start = out.size();
+    size_t sizes_at = start + sizeof(ColumnBlockHeader);
+    out.resize(sizes_at + table.count * sizeof(uint32_t));
+
+    uint32_t sizes[ColumnTable::MAX_COLUMNS];
+    for (uint32_t c = 0; c < table.count && n > 0; c++) {
+        size_t before = out.size();
+        BitWriter w(out);
+        switch (table.columns[c].type) {
+        case COLUMN_DELTA:  encode_delta(frames, n, table.offsets[c], w); break;
+        case COLUMN_FLAG:   encode_flag(frames, n, table.offsets[c], w); break;
+        default:            encode_xor(frames, n, table.offsets[c], w); break;
+        }
+        w.flush();
+        sizes[c] = (uint32_t)(out.size() - before);
+    }
+
+    ColumnBlockHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = ColumnBlockHeader::MAGIC;
+    h.frames = (uint32_t)n;
+    h.num_columns = table.count;
+    h.payload_bytes = (uint32_t)(out.size() - sizes_at);
+    if (n > 0) {
+        h.first_seq = frames[0].seq;
+        h.last_seq = frames[n - 1].seq;
+        h.first_stamp_ns = frames[0].stamp_ns;
+        h.last_stamp_ns = frames[n - 1].stamp_ns;
+        h.min_physics_s = h.max_physics_s = frames[0].state.m_currentPhysicsTime_SEC;
+        for (size_t i = 1; i < n; i++) {
+            double t = frames[i].state.m_currentPhysicsTime_SEC;
+            if (t < h.min_physics_s) h.min_physics_s = t;
+            if (t > h.max_physics_s) h.max_physics_s = t;
+        }
+    } else {
+        memset(sizes, 0, sizeof(sizes));
+    }
+    memcpy(&out[start], &h, sizeof(h));
+    memcpy(&out[sizes_at], sizes, table.count * sizeof(uint32_t));
+}
+
+
+// ---- ColumnLogWriter -----------------------------------------------------------
+
+ColumnLogWriter::ColumnLogWriter()
+    : m_fd(-1),
+      m_block_frames(0),
+      m_frames_written(0),
+      m_blocks(0),
+      m_bytes(0),
+      m_running(false)
+{}
+
+
+ColumnLogWriter::~ColumnLogWriter() {
+    close();
+}
+
+
+bool ColumnLogWriter::open(const char* path, const std::shared_ptr<Ring>& ring, uint32_t block_frames) {
+    close();
+    if (!ring || block_frames == 0 || block_frames > ColumnLogHeader::MAX_BLOCK_FRAMES) {
+        return false;
+    }
+    int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        RF_LOG(LOG_ERROR, "ColumnLogWriter: can't create %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    uint32_t num_columns;
+    const ColumnInfo* columns = column_log_columns(num_columns);
+    ColumnLogHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.version = ColumnLogHeader::VERSION;
+    h.num_columns = num_columns;
+    h.block_frames = block_frames;
+    struct timespec rt;
+    clock_gettime(CLOCK_REALTIME, &rt);
+    h.monotonic_ns = monotonic_ns();
+    h.realtime_ns = (int64_t)rt.tv_sec * 1000000000LL + rt.tv_nsec;
+
+    if (!write_all(fd, (const uint8_t*)&h, sizeof(h)) ||
+        !write_all(fd, (const uint8_t*)columns, num_columns * sizeof(ColumnInfo))) {
+        RF_LOG(LOG_ERROR, "ColumnLogWriter: can't write %s: %s", path, strerror(errno));
+        ::close(fd);
+        return false;
+    }
+
+    m_fd = fd;
+    m_path = path;
+    m_ring = ring;
+    m_block_frames = block_frames;
+    m_pending.clear();
+    m_pending.reserve(block_frames);
+    m_bytes = sizeof(h) + num_columns * sizeof(ColumnInfo);
+
+    m_running = true;
+    m_thread = std::thread(&ColumnLogWriter::run, this);
+    return true;
+}
+
+
+void ColumnLogWriter::close() {
+    m_running = false;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    m_ring.reset();
+}
+
+
+void ColumnLogWriter::run() {
+    while (m_running) {
+        drain();
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    drain();
+    if (!m_pending.empty()) {
+        write_block();
+    }
+}
+
+
+void ColumnLogWriter::drain() {
+    StateFrame frame;
+    while (m_ring->pop(frame)) {
+        m_pending.push_back(frame);
+        if (m_pending.size() == m_block_frames) {
+            write_block();
+        }
+    }
+}
+
+
+void ColumnLogWriter::write_block() {
+    m_encoded.clear();
+    encode_column_block(m_pending.data(), m_pending.size(), m_encoded);
+    if (!write_all(m_fd, m_encoded.data(), m_encoded.size())) {
+        RF_LOG(LOG_ERROR, "ColumnLogWriter: write to %s failed: %s", m_path.c_str(), strerror(errno));
+    } else {
+        m_frames_written.fetch_add(m_pending.size(), std::memory_order_relaxed);
+        m_blocks.fetch_add(1, std::memory_order_relaxed);
+        m_bytes.fetch_add(m_encoded.size(), std::memory_order_relaxed);
+    }
+    m_pending.clear();
+}
+
+
+// ---- ColumnLogReader -----------------------------------------------------------
+
+ColumnLogReader::ColumnLogReader()
+    : m_fd(-1),
+      m_file_size(0),
+      m_next_offset(0),
+      m_have_block(false)
+{
+    memset(&m_header, 0, sizeof(m_header));
+    memset(&m_block, 0, sizeof(m_block));
+}
+
+
+ColumnLogReader::~ColumnLogReader() {
+    close();
+}
+
+
+bool ColumnLogReader::open(const char* path) {
+    close();
+    m_fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (m_fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(m_fd, &st) != 0 ||
+        pread(m_fd, &m_header, sizeof(m_header), 0) != (ssize_t)sizeof(m_header) ||
+        memcmp(m_header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        m_header.version != ColumnLogHeader::VERSION ||
+        m_header.num_columns == 0 || m_header.num_columns > 4096 ||
+        m_header.block_frames == 0 || m_header.block_frames > ColumnLogHeader::MAX_BLOCK_FRAMES) {
+        close();
+        return false;
+    }
+    m_file_size = st.st_size;
+
+    size_t table_bytes = m_header.num_columns * sizeof(ColumnInfo);
+    m_columns.resize(m_header.num_columns);
+    if (pread(m_fd, m_columns.data(), table_bytes, sizeof(m_header)) != (ssize_t)table_bytes) {
+        close();
+        return false;
+    }
+    for (size_t i = 0; i < m_columns.size(); i++) {
+        m_columns[i].name[sizeof(m_columns[i].name) - 1] = '\0';
+    }
+    m_next_offset = sizeof(m_header) + table_bytes;
+    return true;
+}
+
+
+void ColumnLogReader::close() {
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    m_columns.clear();
+    m_have_block = false;
+}
+
+
+int ColumnLogReader::find_column(const char* name) const {
+    for (size_t i = 0; i < m_columns.size(); i++) {
+        if (strcmp(m_columns[i].name, name) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+
+bool ColumnLogReader::next_block(ColumnBlockInfo& block) {
+    return read_block_at(m_next_offset, block);
+}
+
+
+bool ColumnLogReader::seek_block(uint64_t offset, ColumnBlockInfo& block) {
+    return read_block_at(offset, block);
+}
+
+
+bool ColumnLogReader::read_block_at(uint64_t offset, ColumnBlockInfo& block) {
+    m_have_block = false;
+    ColumnBlockHeader h;
+    if (m_fd < 0 || offset + sizeof(h) > m_file_size ||
+        pread(m_fd, &h, sizeof(h), offset) != (ssize_t)sizeof(h) ||
+        h.magic != ColumnBlockHeader::MAGIC || h.num_columns != m_columns.size() ||
+        h.frames > m_header.block_frames ||     // sizes the decode buffers
+        offset + sizeof(h) + h.payload_bytes > m_file_size) {
+        return false;
+    }
+
+    size_t sizes_bytes = h.num_columns * sizeof(uint32_t);
+    m_column_bytes.resize(h.num_columns);
+    if (h.payload_bytes < sizes_bytes ||
+        pread(m_fd, m_column_bytes.data(), sizes_bytes, offset + sizeof(h)) != (ssize_t)sizes_bytes) {
+        return false;
+    }
+    m_column_offsets.resize(h.num_columns);
+    uint64_t at = offset + sizeof(h) + sizes_bytes;
+    for (size_t c = 0; c < h.num_columns; c++) {
+        m_column_offsets[c] = at;
+        at += m_column_bytes[c];
+    }
+    if (at != offset + sizeof(h) + h.payload_bytes) {
+        return false;
+    }
+
+    m_block.offset = offset;
+    m_block.frames = h.frames;
+    m_block.first_seq = h.first_seq;
+    m_block.last_seq = h.last_seq;
+    m_block.first_stamp_ns = h.first_stamp_ns;
+    m_block.last_stamp_ns = h.last_stamp_ns;
+    m_block.min_physics_s = h.min_physics_s;
+    m_block.max_physics_s = h.max_physics_s;
+    m_next_offset = at;
+    m_have_block = true;
+    block = m_block;
+    return true;
+}
+
+
+bool ColumnLogReader::load_column(size_t col) {
+    if (!m_have_block || col >= m_columns.size()) {
+        return false;
+    }
+    m_buffer.resize(m_column_bytes[col]);
+    return m_buffer.empty() ||
+           pread(m_fd, m_buffer.data(), m_buffer.size(), m_column_offsets[col]) == (ssize_t)m_buffer.size();
+}
+
+
+bool ColumnLogReader::read_column(size_t col, std::vector<double>& out) {
+    if (!load_column(col)) {
+        return false;
+    }
+    std::vector<uint64_t> raw(m_block.frames);
+    if (!decode(m_buffer.data(), m_buffer.size(), m_columns[col].type, raw.size(), raw.data())) {
+        return false;
+    }
+    out.resize(raw.size());
+    for (size_t i = 0; i < raw.size(); i++) {
+        out[i] = m_columns[col].type == COLUMN_DELTA ? (double)(int64_t)raw[i] : bits_double(raw[i]);
+    }
+    return true;
+}
+
+
+bool ColumnLogReader::read_column(size_t col, std::vector<int64_t>& out) {
+    if (!load_column(col) || m_columns[col].type != COLUMN_DELTA) {
+        return false;
+    }
+    out.resize(m_block.frames);
+    return decode(m_buffer.data(), m_buffer.size(), COLUMN_DELTA, out.size(), (uint64_t*)out.data());
+}
+
+
+bool ColumnLogReader::read_frames(std::vector<StateFrame>& out) {
+    const ColumnTable& table = column_table();
+    if (!m_have_block || m_columns.size() != table.count) {
+        return false;
+    }
+    out.resize(m_block.frames);
+    std::vector<uint64_t> raw(m_block.frames);
+    for (uint32_t c = 0; c < table.count; c++) {
+        if (strcmp(m_columns[c].name, table.columns[c].name) != 0 ||
+            m_columns[c].type != table.columns[c].type || !load_column(c) ||
+            !decode(m_buffer.data(), m_buffer.size(), m_columns[c].type, raw.size(), raw.data())) {
+            return false;
+        }
+        for (size_t i = 0; i < raw.size(); i++) {
+            memcpy((char*)&out[i] + table.offsets[c], &raw[i], sizeof(raw[i]));
+        }
+    }
+    return true;
+}
+
+} // namespace RF
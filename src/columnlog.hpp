@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rfstate.hpp"
+#include "spscring.hpp"
+
+namespace RF {
+
+// How a column's values are encoded within a block. Every column of every block
+// starts from a raw first value, so one column of one block decodes on its own.
+enum ColumnType {
+    COLUMN_XOR = 1,     // doubles, Gorilla XOR against the previous value
+    COLUMN_DELTA = 2,   // int64 (seq, stamp_ns), delta of delta in 1/10/19/36/68 bits
+    COLUMN_FLAG = 3,    // doubles that are mostly 0/1: 1 bit unchanged, 2 bits toggled
+};
+
+struct ColumnInfo {
+    char name[48];      // "seq", "stamp_ns", "rcin0".."rcin11", then the reply tags
+    uint32_t type;      // ColumnType
+    uint32_t reserved;
+};
+
+// File: ColumnLogHeader, num_columns ColumnInfos, then blocks one after the other
+struct ColumnLogHeader {
+    static const uint32_t VERSION = 1;
+    static const uint32_t MAX_BLOCK_FRAMES = 1 << 20;
+
+    char magic[8];              // "RFCOLLOG"
+    uint32_t version;
+    uint32_t num_columns;
+    uint32_t block_frames;      // frames per block (the last one may have fewer), at
+                                // most MAX_BLOCK_FRAMES
+    uint32_t reserved;
+    int64_t realtime_ns;        // CLOCK_REALTIME and monotonic_ns() at the same
+    int64_t monotonic_ns;       // moment, to put the stamps on the calendar
+};
+
+// Block: this header, num_columns uint32_t column sizes in bytes, then the columns
+struct ColumnBlockHeader {
+    static const uint32_t MAGIC = 0x42434652;   // "RFCB"
+
+    uint32_t magic;
+    uint32_t frames;
+    uint64_t first_seq;
+    uint64_t last_seq;
+    int64_t first_stamp_ns;
+    int64_t last_stamp_ns;
+    double min_physics_s;       // m-currentPhysicsTime-SEC over the block (it can
+    double max_physics_s;       // go backwards on a restart)
+    uint32_t num_columns;
+    uint32_t payload_bytes;     // column sizes + columns
+};
+
+// The column table of this build, in StateFrame order
+const ColumnInfo* column_log_columns(uint32_t& count);
+
+// Encode frames[0, n) as one block (header, sizes, columns) appended to out
+void encode_column_block(const StateFrame* frames, size_t n, std::vector<uint8_t>& out);
+
+// Writes every frame that arrives on a telemetry ring (RFInterfaceBase::subscribe)
+// to a columnar log, block_frames frames to a block, from a thread of its own: it
+// drains the ring, encodes and writes whole blocks, so the update thread does no
+// more than for any other subscriber. Frames the ring drops when the writer falls
+// behind show up as seq gaps, and in lost().
+class ColumnLogWriter {
+public:
+    typedef SpscRing<StateFrame> Ring;
+
+    ColumnLogWriter();
+    ~ColumnLogWriter();
+
+    bool open(const char* path, const std::shared_ptr<Ring>& ring, uint32_t block_frames = 1024);
+
+    // Drain the ring, write the last (partial) block and close the file. Stop the
+    // ring's producer first to get every frame.
+    void close();
+    bool is_open() const { return m_fd >= 0; }
+
+    uint64_t frames() const { return m_frames_written.load(std::memory_order_relaxed); }
+    uint64_t blocks() const { return m_blocks.load(std::memory_order_relaxed); }
+    uint64_t bytes() const { return m_bytes.load(std::memory_order_relaxed); }
+    uint64_t lost() const { return m_ring ? m_ring->overruns() : 0; }
+
+private:
+    void run();
+    void drain();
+    void write_block();
+
+    int m_fd;
+    std::string m_path;
+    std::shared_ptr<Ring> m_ring;
+    uint32_t m_block_frames;
+    std::vector<StateFrame> m_pending;
+    std::vector<uint8_t> m_encoded;
+
+    std::atomic<uint64_t> m_frames_written;
+    std::atomic<uint64_t> m_blocks;
+    std::atomic<uint64_t> m_bytes;
+
+    std::atomic<bool> m_running;
+    std::thread m_thread;
+};
+
+// Where a block is and what it covers, from its header alone
+struct ColumnBlockInfo {
+    uint64_t offset;            // of the block header in the file
+    uint32_t frames;
+    uint64_t first_seq;
+    uint64_t last_seq;
+    int64_t first_stamp_ns;
+    int64_t last_stamp_ns;
+    double min_physics_s;
+    double max_physics_s;
+};
+
+// Reads a columnar log block by block. next_block() reads a block's header and column
+// sizes only; read_column() then reads and decodes just that column's bytes.
+class ColumnLogReader {
+public:
+    ColumnLogReader();
+    ~ColumnLogReader();
+
+    bool open(const char* path);
+    void close();
+
+    const ColumnLogHeader& header() const { return m_header; }
+    size_t num_columns() const { return m_columns.size(); }
+    const ColumnInfo& column(size_t i) const { return m_columns[i]; }
+    int find_column(const char* name) const;        // -1 if there's none
+
+    // The next block in the file; false at the end or at a block cut short
+    bool next_block(ColumnBlockInfo& block);
+
+    // Continue from the block at offset (a ColumnBlockInfo::offset seen before)
+    bool seek_block(uint64_t offset, ColumnBlockInfo& block);
+
+    // Decode column col of the current block. The int64_t version is exact for
+    // COLUMN_DELTA columns and fails for the others.
+    bool read_column(size_t col, std::vector<double>& out);
+    bool read_column(size_t col, std::vector<int64_t>& out);
+
+    // Decode every column of the current block back into frames. Fails unless the
+    // file has exactly this build's columns (column_log_columns()).
+    bool read_frames(std::vector<StateFrame>& out);
+
+    // Encoded size of column col in the current block
+    uint32_t column_bytes(size_t col) const { return m_column_bytes[col]; }
+
+private:
+    bool read_block_at(uint64_t offset, ColumnBlockInfo& block);
+    bool load_column(size_t col);
+
+    int m_fd;
+    uint64_t m_file_size;
+    ColumnLogHeader m_header;
+    std::vector<ColumnInfo> m_columns;
+
+    uint64_t m_next_offset;
+    ColumnBlockInfo m_block;
+    bool m_have_block;
+    std::vector<uint32_t> m_column_bytes;
+    std::vector<uint64_t> m_column_offsets;
+    std::vector<uint8_t> m_buffer;
+};
+
+} // namespace RF
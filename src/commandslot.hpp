@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <atomic>
+
+#include "rfcmd.hpp"
+#include "seqlock.hpp"
+
+namespace RF {
+
+// A command together with when it was produced and its position in the publish order
+struct Setpoint {
+    RFCmd cmd;
+    int64_t stamp_ns;   // monotonic_ns() at the producer
+    uint64_t seq;       // 1 for the first publish, 0 means "never published"
+};
+
+// Latest-wins mailbox between command producers (joystick, autopilot, scripts) and the
+// exchange thread. Producers overwrite the pending setpoint; the exchange thread takes
+// whatever is newest when it builds a request. Nothing ever queues behind a slow
+// exchange - setpoints overwritten before they were taken are counted as superseded.
+//
+// Producers serialise among themselves on a mutex, but the exchange thread reads
+// through a seqlock and never waits for a producer.
+class CommandSlot {
+public:
+    CommandSlot() : m_taken_seq(0), m_superseded(0), m_published(0) {
+        m_pending.cmd = neutral_cmd();
+        m_pending.stamp_ns = 0;
+        m_pending.seq = 0;
+        m_latest.store(m_pending);
+    }
+
+    // Called from any producer thread. A setpoint older than the pending one (by
+    // timestamp) is already stale and is dropped as superseded.
+    void publish(const RFCmd& cmd, int64_t stamp_ns) {
+        std::lock_guard<std::mutex> lock(m_write_mutex);
+        m_published.fetch_add(1, std::memory_order_relaxed);
+        if (m_pending.seq != 0 && stamp_ns < m_pending.stamp_ns) {
+            m_superseded.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        m_pending.cmd = cmd;
+        m_pending.stamp_ns = stamp_ns;
+        m_pending.seq++;
+        m_latest.store(m_pending);
+    }
+
+    void publish(const RFCmd& cmd) {
+        publish(cmd, monotonic_ns());
+    }
+
+    // Called from the (single) exchange thread. Returns false if nothing new was
+    // published since the last take. superseded is set to the number of setpoints that
+    // were overwritten in between and will never be sent.
+    bool take(Setpoint& out, uint64_t& superseded) {
+        superseded = 0;
+        Setpoint latest;
+        m_latest.load(latest);
+        if (latest.seq == m_taken_seq) {
+            return false;
+        }
+        superseded = latest.seq - m_taken_seq - 1;
+        m_superseded.fetch_add(superseded, std::memory_order_relaxed);
+        m_taken_seq = latest.seq;
+        out = latest;
+        return true;
+    }
+
+    // Totals since construction
+    uint64_t superseded() const { return m_superseded.load(std::memory_order_relaxed); }
+    uint64_t published() const { return m_published.load(std::memory_order_relaxed); }
+
+private:
+    std::mutex m_write_mutex;
+    Setpoint m_pending;             // producers' copy, under m_write_mutex
+    Seqlock<Setpoint> m_latest;
+    uint64_t m_taken_seq;           // exchange thread only
+
+    std::atomic<uint64_t> m_superseded;
+    std::atomic<uint64_t> m_published;
+};
+
+} // namespace RF
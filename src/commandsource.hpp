@@ -0,0 +1,333 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <iostream>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "rfcmd.hpp"
+#include "commandslot.hpp"
+#include "shmcommand.hpp"
+#include "joystick.hpp"
+#include "rtthread.hpp"
+
+namespace RF {
+
+// Command sources for BasicRFInterface<Source>. A source is any class with
+//
+//   // Called by the update thread before every exchange. Returns true and fills out
+//   // with a new setpoint if there is one (superseded = newer-than-last setpoints
+//   // that will never be sent), false to re-send the previous command.
+//   bool take(Setpoint& out, uint64_t& superseded);
+//
+//   // Pin / prioritise the source's own thread, if it has one
+//   bool configureThread(const ThreadConfig& cfg);
+//
+// Fixing the source as a template argument lets the compiler inline take() into the
+// update loop. DynamicSource wraps the virtual CommandSource interface for picking a
+// source at runtime.
+
+// Sticks centred, throttle closed, forever. For running with nothing attached.
+class NeutralSource {
+public:
+    NeutralSource() : m_sent(false) {}
+
+    bool take(Setpoint& out, uint64_t& superseded) {
+        superseded = 0;
+        if (m_sent) {
+            return false;
+        }
+        out.cmd = neutral_cmd();
+        out.stamp_ns = monotonic_ns();
+        out.seq = 1;
+        m_sent = true;
+        return true;
+    }
+
+    bool configureThread(const ThreadConfig&) { return false; }
+
+private:
+    bool m_sent;
+};
+
+
+// In-process producers (autopilot, scripts, tests) publish into slot()
+class SlotSource {
+public:
+    bool take(Setpoint& out, uint64_t& superseded) { return m_slot.take(out, superseded); }
+    bool configureThread(const ThreadConfig&) { return false; }
+
+    CommandSlot& slot() { return m_slot; }
+    void publish(const RFCmd& cmd) { m_slot.publish(cmd); }
+
+private:
+    CommandSlot m_slot;
+};
+
+
+// evdev joystick. Publishes a complete command on every EV_SYN; sends neutral if the
+// device isn't there. The exchange thread takes it straight from the joystick's
+// triple buffer, so it never waits on the input thread.
+class JoystickSource {
+public:
+    explicit JoystickSource(const char* device = "/dev/input/event0")
+        : m_joystick(device),
+          m_taken_seq(0)
+    {}
+
+    ~JoystickSource() {
+        m_joystick.stop_reading();
+    }
+
+    bool take(Setpoint& out, uint64_t& superseded) {
+        superseded = 0;
+        if (!m_joystick.takeSetpoint(out)) {
+            return false;
+        }
+        superseded = out.seq - m_taken_seq - 1;
+        m_taken_seq = out.seq;
+        return true;
+    }
+
+    bool configureThread(const ThreadConfig& cfg) { return m_joystick.configureThread(cfg); }
+
+    Joystick& joystick() { return m_joystick; }
+
+private:
+    Joystick m_joystick;
+    uint64_t m_taken_seq;   // exchange thread only
+};
+
+
+// Setpoints written by another process through ShmCommandWriter
+class ShmSource {
+public:
+    explicit ShmSource(const char* name = "/rf_commands") {
+        if (m_channel.create(name)) {
+            std::cout << "[INFO] ShmSource: taking commands from shm " << name << std::endl;
+        }
+    }
+
+    bool take(Setpoint& out, uint64_t& superseded) { return m_channel.take(out, superseded); }
+    bool configureThread(const ThreadConfig&) { return false; }
+
+private:
+    ShmCommandChannel m_channel;
+};
+
+
+// Datagram sent to UdpSource, in host byte order
+struct UdpCommandPacket {
+    static const uint32_t MAGIC = 0x55434652;   // "RFCU"
+
+    uint32_t magic;
+    uint32_t channel_mask;      // as RFCmd::channel_mask
+    double throttle;
+    double aileron;
+    double elevator;
+    double rudder;
+    double flaps;
+    double gear;
+    double channels[RF_NUM_CHANNELS];
+};
+
+// Setpoints arriving as UdpCommandPacket datagrams. Each take() drains the socket
+// without blocking; only the newest datagram is used.
+class UdpSource {
+public:
+    explicit UdpSource(uint16_t port, const char* bind_ip = "0.0.0.0")
+        : m_fd(-1),
+          m_seq(0)
+    {
+        m_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (m_fd < 0) {
+            std::cerr << "[ERROR] UdpSource: socket failed: " << strerror(errno) << std::endl;
+            return;
+        }
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        if (inet_pton(AF_INET, bind_ip, &addr.sin_addr) <= 0 ||
+            bind(m_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+            std::cerr << "[ERROR] UdpSource: bind " << bind_ip << ":" << port << " failed: "
+                      << strerror(errno) << std::endl;
+            close(m_fd);
+            m_fd = -1;
+            return;
+        }
+        std::cout << "[INFO] UdpSource: listening on " << bind_ip << ":" << port << std::endl;
+    }
+
+    ~UdpSource() {
+        if (m_fd >= 0) close(m_fd);
+    }
+
+    bool take(Setpoint& out, uint64_t& superseded) {
+        superseded = 0;
+        if (m_fd < 0) {
+            return false;
+        }
+
+        uint64_t received = 0;
+        UdpCommandPacket packet;
+        UdpCommandPacket newest;
+        for (;;) {
+            ssize_t n = recv(m_fd, &packet, sizeof(packet), MSG_DONTWAIT);
+            if (n < 0) {
+                break;  // EAGAIN: drained
+            }
+            if ((size_t)n != sizeof(packet) || packet.magic != UdpCommandPacket::MAGIC) {
+                continue;
+            }
+            newest = packet;
+            received++;
+        }
+        if (received == 0) {
+            return false;
+        }
+
+        out.cmd.throttle = newest.throttle;
+        out.cmd.aileron = newest.aileron;
+        out.cmd.elevator = newest.elevator;
+        out.cmd.rudder = newest.rudder;
+        out.cmd.flaps = newest.flaps;
+        out.cmd.gear = newest.gear;
+        out.cmd.channel_mask = newest.channel_mask;
+        memcpy(out.cmd.channels, newest.channels, sizeof(out.cmd.channels));
+        out.cmd.input_ns = 0;
+        out.stamp_ns = monotonic_ns();  // the sender's clock isn't ours
+        out.seq = ++m_seq;
+        superseded = received - 1;
+        return true;
+    }
+
+    bool configureThread(const ThreadConfig&) { return false; }
+
+private:
+    int m_fd;
+    uint64_t m_seq;
+};
+
+
+// A timed sequence of commands, e.g. for repeatable test manoeuvres
+struct ScriptStep {
+    double t_s;     // seconds after the first exchange
+    RFCmd cmd;
+};
+
+// Plays steps in order (each held until the next one's time). With a loop period it
+// starts over from the first step every loop_period_s; steps at or past the period
+// never play, so give the last step room before it.
+class ScriptedSource {
+public:
+    explicit ScriptedSource(const std::vector<ScriptStep>& steps, double loop_period_s = 0.0)
+        : m_steps(steps),
+          m_loop_period_s(loop_period_s),
+          m_start_ns(0),
+          m_pass(0),
+          m_index(-1),
+          m_seq(0)
+    {}
+
+    bool take(Setpoint& out, uint64_t& superseded) {
+        superseded = 0;
+        if (m_steps.empty()) {
+            return false;
+        }
+
+        int64_t now = monotonic_ns();
+        if (m_start_ns == 0) {
+            m_start_ns = now;
+        }
+        double elapsed = (now - m_start_ns) / 1e9;
+        if (m_loop_period_s > 0.0) {
+            uint64_t pass = (uint64_t)(elapsed / m_loop_period_s);
+            if (pass != m_pass) {
+                // New pass: start over from the first step
+                m_pass = pass;
+                m_index = -1;
+            }
+            elapsed -= pass * m_loop_period_s;
+        }
+
+        long index = m_index;
+        while (index + 1 < (long)m_steps.size() && m_steps[index + 1].t_s <= elapsed) {
+            index++;
+        }
+        if (index == m_index || index < 0) {
+            return false;
+        }
+
+        superseded = index - m_index - 1;
+        m_index = index;
+        out.cmd = m_steps[index].cmd;
+        out.stamp_ns = now;
+        out.seq = ++m_seq;
+        return true;
+    }
+
+    bool configureThread(const ThreadConfig&) { return false; }
+
+private:
+    std::vector<ScriptStep> m_steps;
+    double m_loop_period_s;     // 0: play once
+    int64_t m_start_ns;
+    uint64_t m_pass;
+    long m_index;       // step currently being held in this pass, -1 before the first
+    uint64_t m_seq;
+};
+
+
+// Runtime-polymorphic source, for when the choice isn't known at compile time
+class CommandSource {
+public:
+    virtual ~CommandSource() {}
+    virtual bool take(Setpoint& out, uint64_t& superseded) = 0;
+    virtual bool configureThread(const ThreadConfig& cfg) = 0;
+};
+
+// Any compile-time source as a CommandSource
+template <class Source>
+class SourceAdapter final : public CommandSource {
+public:
+    template <class... Args>
+    explicit SourceAdapter(Args&&... args) : m_source(std::forward<Args>(args)...) {}
+
+    bool take(Setpoint& out, uint64_t& superseded) override { return m_source.take(out, superseded); }
+    bool configureThread(const ThreadConfig& cfg) override { return m_source.configureThread(cfg); }
+
+    Source& source() { return m_source; }
+
+private:
+    Source m_source;
+};
+
+// Source policy that forwards to a CommandSource chosen at runtime (one virtual call
+// per exchange). Takes ownership.
+class DynamicSource {
+public:
+    explicit DynamicSource(CommandSource* impl) : m_impl(impl) {}
+
+    bool take(Setpoint& out, uint64_t& superseded) {
+        superseded = 0;
+        return m_impl ? m_impl->take(out, superseded) : false;
+    }
+
+    bool configureThread(const ThreadConfig& cfg) {
+        return m_impl ? m_impl->configureThread(cfg) : false;
+    }
+
+private:
+    std::unique_ptr<CommandSource> m_impl;
+};
+
+} // namespace RF
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+#include "rfcmd.hpp"
+
+namespace RF {
+
+// Absolute point on the monotonic clock by which a request must be finished. One
+// deadline is set per request and every phase (connect, send, receive) waits only
+// for what is left of it, so the total can never exceed the budget.
+struct Deadline {
+    int64_t at_ns;
+
+    explicit Deadline(int64_t at = 0) : at_ns(at) {}
+
+    static Deadline after_ms(uint32_t ms) {
+        return Deadline(monotonic_ns() + (int64_t)ms * 1000000LL);
+    }
+
+    int64_t remaining_ns() const {
+        int64_t left = at_ns - monotonic_ns();
+        return left > 0 ? left : 0;
+    }
+};
+
+} // namespace RF
@@ -0,0 +1,530 @@
+#include <cstring>
+#include <cstdlib>
+#include <climits>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <strings.h>
+
+#include <iostream>
+
+#include "epolltransport.hpp"
+#include "logger.hpp"
+#include "rfcmd.hpp"
+
+namespace RF {
+
+static const int64_t PREWARM_RETRY_NS = 100 * 1000000LL;
+
+EpollTransport::EpollTransport()
+    : m_epfd(-1),
+      m_num_endpoints(0),
+      m_in_flight(0),
+      m_have_pwait2(true),
+      m_now(0)
+{
+    memset(m_endpoints, 0, sizeof(m_endpoints));
+    memset(&m_stats, 0, sizeof(m_stats));
+    for (size_t i = 0; i < MAX_OPS; i++) {
+        m_ops[i].phase = FREE;
+        m_ops[i].gen = 0;
+        m_ops[i].fd = -1;
+        m_ops[i].endpoint = -1;
+    }
+
+    m_epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epfd < 0) {
+        std::cerr << "[ERROR] EpollTransport: epoll_create1 failed: " << strerror(errno) << std::endl;
+    }
+}
+
+
+EpollTransport::~EpollTransport() {
+    for (size_t i = 0; i < MAX_OPS; i++) {
+        if (m_ops[i].phase != FREE) {
+            release(i);
+        }
+    }
+    if (m_epfd >= 0) close(m_epfd);
+}
+
+
+int EpollTransport::add_endpoint(const char* ip, uint16_t port, size_t prewarm) {
+    if (m_num_endpoints >= MAX_ENDPOINTS) {
+        return -1;
+    }
+
+    Endpoint& ep = m_endpoints[m_num_endpoints];
+    memset(&ep.addr, 0, sizeof(ep.addr));
+    ep.addr.sin_family = AF_INET;
+    ep.addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, ip, &ep.addr.sin_addr) <= 0) {
+        std::cerr << "[ERROR] EpollTransport: Invalid address: " << ip << std::endl;
+        return -1;
+    }
+    ep.prewarm = prewarm;
+    ep.retry_at_ns = 0;
+
+    int id = m_num_endpoints++;
+    top_up(id);
+    return id;
+}
+
+
+bool EpollTransport::submit(const TransportRequest& req) {
+    return submit(req, monotonic_ns());
+}
+
+
+bool EpollTransport::submit(const TransportRequest& req, int64_t now) {
+    if (m_epfd < 0 || req.endpoint < 0 || (size_t)req.endpoint >= m_num_endpoints ||
+        req.reply_cap < 2) {
+        return false;
+    }
+
+    // Prefer a pre-opened connection, connected ones first
+    int idx = -1;
+    for (size_t i = 0; i < MAX_OPS; i++) {
+        if (m_ops[i].endpoint != req.endpoint) continue;
+        if (m_ops[i].phase == PREWARM_READY) {
+            idx = i;
+            break;
+        }
+        if (m_ops[i].phase == PREWARM_CONNECTING && idx < 0) {
+            idx = i;
+        }
+    }
+
+    Phase phase;
+    if (idx >= 0) {
+        phase = (m_ops[idx].phase == PREWARM_READY) ? SENDING : CONNECTING;
+        m_stats.prewarm_used++;
+    } else {
+        idx = alloc_op();
+        if (idx < 0) {
+            return false;
+        }
+        bool connected = false;
+        int fd = open_socket(req.endpoint, connected);
+        if (fd < 0) {
+            // Reported through the callback like any other failure
+            m_ops[idx].phase = FREE;
+            m_stats.failed++;
+            m_stats.connect_failures++;
+            m_exchanges++;
+            m_times.start = m_times.done = now;
+            m_times.connected = m_times.sent = m_times.first_byte = 0;
+            if (req.on_complete) req.on_complete(req.user, fd, 0);
+            return true;
+        }
+        m_ops[idx].fd = fd;
+        phase = connected ? SENDING : CONNECTING;
+        watch(idx, EPOLLOUT, true);
+    }
+
+    Op& op = m_ops[idx];
+    op.phase = phase;
+    op.endpoint = req.endpoint;
+    op.data = req.data;
+    op.len = req.len;
+    op.sent = 0;
+    op.reply = req.reply;
+    op.reply_cap = req.reply_cap;
+    op.received = 0;
+    op.framer.reset();
+    op.deadline_ns = req.deadline.at_ns;
+    op.times.start = now;
+    op.times.connected = (phase == SENDING) ? now : 0;
+    op.times.sent = op.times.first_byte = op.times.done = 0;
+    op.on_complete = req.on_complete;
+    op.user = req.user;
+    op.reply[0] = '\0';
+    m_in_flight++;
+
+    if (phase == SENDING) {
+        // Connected already: don't wait for a round through epoll_wait
+        watch(idx, EPOLLOUT, false);
+        try_send(idx);
+    }
+
+    top_up(req.endpoint);
+    return true;
+}
+
+
+int EpollTransport::run_once(int max_wait_ms) {
+    if (m_epfd < 0) {
+        return 0;
+    }
+
+    const uint64_t completed_before = m_stats.completed + m_stats.failed;
+    int64_t now = monotonic_ns();
+
+    // Sleep no longer than the earliest deadline or pending pre-open retry
+    int64_t wake_ns = (max_wait_ms < 0) ? INT64_MAX : now + (int64_t)max_wait_ms * 1000000LL;
+    for (size_t i = 0; i < MAX_OPS; i++) {
+        const Op& op = m_ops[i];
+        if (op.phase >= CONNECTING && op.deadline_ns < wake_ns) {
+            wake_ns = op.deadline_ns;
+        }
+    }
+    for (size_t e = 0; e < m_num_endpoints; e++) {
+        if (m_endpoints[e].prewarm > 0 && m_endpoints[e].retry_at_ns > now &&
+            m_endpoints[e].retry_at_ns < wake_ns) {
+            wake_ns = m_endpoints[e].retry_at_ns;
+        }
+    }
+
+    struct epoll_event events[MAX_OPS];
+    int n = wait_events(events, wake_ns == INT64_MAX ? -1 : wake_ns - now);
+    if (n < 0 && errno != EINTR) {
+        RF_LOG(LOG_ERROR, "EpollTransport: epoll_wait failed: %s", strerror(errno));
+    }
+    // One timestamp for the whole batch: it is when these events were seen
+    now = monotonic_ns();
+    m_now = now;
+    for (int i = 0; i < n; i++) {
+        handle_event(events[i].data.u64, events[i].events);
+    }
+
+    // Expire whatever ran out of budget
+    for (size_t i = 0; i < MAX_OPS; i++) {
+        if (m_ops[i].phase >= CONNECTING && m_ops[i].deadline_ns <= now) {
+            m_stats.timed_out++;
+            complete(i, -ETIMEDOUT);
+        }
+    }
+
+    for (size_t e = 0; e < m_num_endpoints; e++) {
+        top_up(e);
+    }
+
+    return (int)(m_stats.completed + m_stats.failed - completed_before);
+}
+
+
+namespace {
+struct Waiter {
+    bool done;
+    int status;
+    size_t len;
+};
+
+void on_exchange_complete(void* user, int status, size_t len) {
+    Waiter* w = static_cast<Waiter*>(user);
+    w->done = true;
+    w->status = status;
+    w->len = len;
+}
+}
+
+
+ssize_t EpollTransport::exchange(int endpoint, const char* data, size_t len,
+                                 char* reply, size_t reply_cap, const Deadline& deadline) {
+    Waiter waiter = { false, 0, 0 };
+    int64_t now = monotonic_ns();
+    if (deadline.at_ns <= now) {
+        m_stats.timed_out++;
+        m_exchanges++;
+        m_times.start = m_times.done = now;
+        m_times.connected = m_times.sent = m_times.first_byte = 0;
+        return -ETIMEDOUT;
+    }
+
+    TransportRequest req;
+    req.endpoint = endpoint;
+    req.data = data;
+    req.len = len;
+    req.reply = reply;
+    req.reply_cap = reply_cap;
+    req.deadline = deadline;
+    req.on_complete = &on_exchange_complete;
+    req.user = &waiter;
+
+    if (!submit(req, now)) {
+        return -EBUSY;
+    }
+    while (!waiter.done) {
+        run_once(-1);
+    }
+    return (waiter.status < 0) ? waiter.status : (ssize_t)waiter.len;
+}
+
+
+// epoll_wait with the remaining budget (-1: forever). Uses epoll_pwait2 where the
+// kernel has it so deadlines are honoured to the nanosecond rather than rounded up to
+// the next millisecond.
+int EpollTransport::wait_events(struct epoll_event* events, int64_t wait_ns) {
+#ifdef __NR_epoll_pwait2
+    if (m_have_pwait2) {
+        struct timespec ts;
+        ts.tv_sec = wait_ns / 1000000000LL;
+        ts.tv_nsec = wait_ns % 1000000000LL;
+        int n = (int)syscall(__NR_epoll_pwait2, m_epfd, events, (int)MAX_OPS,
+                             wait_ns < 0 ? nullptr : &ts, nullptr, 0);
+        m_syscalls++;
+        if (n >= 0 || errno != ENOSYS) {
+            return n;
+        }
+        m_have_pwait2 = false;
+    }
+#endif
+    int timeout_ms = (wait_ns < 0) ? -1 : (int)((wait_ns + 999999) / 1000000);
+    m_syscalls++;
+    return epoll_wait(m_epfd, events, MAX_OPS, timeout_ms);
+}
+
+
+int EpollTransport::alloc_op() {
+    for (size_t i = 0; i < MAX_OPS; i++) {
+        if (m_ops[i].phase == FREE) {
+            m_ops[i].gen++;
+            m_ops[i].fd = -1;
+            m_ops[i].endpoint = -1;
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+// Non-blocking socket with connect() started. Returns the fd or a negative errno.
+int EpollTransport::open_socket(int endpoint, bool& connected) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    m_syscalls++;
+    if (fd < 0) {
+        int err = errno;
+        RF_LOG(LOG_ERROR, "EpollTransport: Socket creation failed: %s", strerror(err));
+        return -err;
+    }
+
+    const struct sockaddr_in& addr = m_endpoints[endpoint].addr;
+    m_syscalls++;
+    if (::connect(fd, (const struct sockaddr*)&addr, sizeof(addr)) == 0) {
+        connected = true;
+        return fd;
+    }
+    if (errno != EINPROGRESS) {
+        int err = errno;
+        close(fd);
+        return -err;
+    }
+    connected = false;
+    return fd;
+}
+
+
+// Keep the configured number of pre-opened connections per endpoint
+void EpollTransport::top_up(int endpoint) {
+    Endpoint& ep = m_endpoints[endpoint];
+    if (ep.prewarm == 0 || m_epfd < 0) {
+        return;
+    }
+    if (ep.retry_at_ns != 0) {
+        if (monotonic_ns() < ep.retry_at_ns) return;
+        ep.retry_at_ns = 0;
+    }
+
+    size_t open = 0;
+    for (size_t i = 0; i < MAX_OPS; i++) {
+        if (m_ops[i].endpoint == endpoint &&
+            (m_ops[i].phase == PREWARM_CONNECTING || m_ops[i].phase == PREWARM_READY)) {
+            open++;
+        }
+    }
+
+    while (open < ep.prewarm) {
+        int idx = alloc_op();
+        if (idx < 0) {
+            return;
+        }
+        bool connected = false;
+        int fd = open_socket(endpoint, connected);
+        if (fd < 0) {
+            m_stats.connect_failures++;
+            ep.retry_at_ns = monotonic_ns() + PREWARM_RETRY_NS;
+            return;
+        }
+        Op& op = m_ops[idx];
+        op.fd = fd;
+        op.endpoint = endpoint;
+        op.phase = connected ? PREWARM_READY : PREWARM_CONNECTING;
+        watch(idx, connected ? EPOLLRDHUP : EPOLLOUT, true);
+        open++;
+    }
+}
+
+
+void EpollTransport::handle_event(uint64_t key, uint32_t events) {
+    int idx = (int)(key & 0xffffffffu);
+    Op& op = m_ops[idx];
+    if (op.gen != (uint32_t)(key >> 32)) {
+        return;     // the op completed earlier in this batch and the slot was reused
+    }
+
+    switch (op.phase) {
+        case FREE:
+            break;
+
+        case PREWARM_CONNECTING:
+        case CONNECTING: {
+            int err = 0;
+            socklen_t errlen = sizeof(err);
+            m_syscalls++;
+            if (getsockopt(op.fd, SOL_SOCKET, SO_ERROR, &err, &errlen) < 0) {
+                err = errno;
+            }
+            if (err != 0) {
+                m_stats.connect_failures++;
+                if (op.phase == PREWARM_CONNECTING) {
+                    m_endpoints[op.endpoint].retry_at_ns = monotonic_ns() + PREWARM_RETRY_NS;
+                    release(idx);
+                } else {
+                    complete(idx, -err);
+                }
+                break;
+            }
+            if (op.phase == PREWARM_CONNECTING) {
+                // Only interested in the server dropping it from now on
+                op.phase = PREWARM_READY;
+                watch(idx, EPOLLRDHUP, false);
+            } else {
+                op.phase = SENDING;
+                op.times.connected = m_now;
+                try_send(idx);
+            }
+            break;
+        }
+
+        case PREWARM_READY:
+            if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                release(idx);
+            }
+            break;
+
+        case SENDING:
+            try_send(idx);
+            break;
+
+        case RECEIVING:
+            try_recv(idx);
+            break;
+    }
+}
+
+
+void EpollTransport::try_send(int idx) {
+    Op& op = m_ops[idx];
+
+    while (op.sent < op.len) {
+        ssize_t n = send(op.fd, op.data + op.sent, op.len - op.sent, MSG_NOSIGNAL);
+        m_syscalls++;
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;     // still watching EPOLLOUT
+            }
+            if (errno == EINTR) continue;
+            complete(idx, -errno);
+            return;
+        }
+        op.sent += n;
+    }
+
+    op.phase = RECEIVING;
+    op.times.sent = monotonic_ns();
+    watch(idx, EPOLLIN | EPOLLRDHUP, false);
+}
+
+
+void EpollTransport::try_recv(int idx) {
+    Op& op = m_ops[idx];
+
+    for (;;) {
+        size_t space = op.reply_cap - 1 - op.received;
+        if (space == 0) {
+            // Buffer full before the reply ended: never hand back a truncated reply
+            complete(idx, -EMSGSIZE);
+            return;
+        }
+
+        ssize_t n = recv(op.fd, op.reply + op.received, space, 0);
+        m_syscalls++;
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            if (errno == EINTR) continue;
+            complete(idx, -errno);
+            return;
+        }
+        if (n == 0) {
+            // Server closed before the framer saw the end of the reply (a complete
+            // one returns below): short, like MockSim's truncated replies
+            complete(idx, -ECONNRESET);
+            return;
+        }
+
+        size_t prev = op.received;
+        if (prev == 0) {
+            op.times.first_byte = m_now;
+        }
+        op.received += n;
+        op.reply[op.received] = '\0';
+        if (op.framer.complete(op.reply, op.received, prev)) {
+            complete(idx, 0);
+            return;
+        }
+    }
+}
+
+
+void EpollTransport::watch(int idx, uint32_t events, bool add) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.u64 = ((uint64_t)m_ops[idx].gen << 32) | (uint32_t)idx;
+    m_syscalls++;
+    epoll_ctl(m_epfd, add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, m_ops[idx].fd, &ev);
+}
+
+
+// Close the connection and free the slot without reporting anything
+void EpollTransport::release(int idx) {
+    Op& op = m_ops[idx];
+    if (op.fd >= 0) {
+        // Closing the last reference also removes it from the epoll set
+        close(op.fd);
+        m_syscalls++;
+    }
+    if (op.phase >= CONNECTING) {
+        m_in_flight--;
+    }
+    op.phase = FREE;
+    op.fd = -1;
+    op.endpoint = -1;
+}
+
+
+void EpollTransport::complete(int idx, int status) {
+    Op& op = m_ops[idx];
+    CompletionFn fn = op.on_complete;
+    void* user = op.user;
+    size_t len = op.received;
+    op.times.done = monotonic_ns();
+    m_times = op.times;
+
+    // One request per connection: the socket is never reused
+    release(idx);
+
+    m_exchanges++;
+    if (status < 0) {
+        m_stats.failed++;
+    } else {
+        m_stats.completed++;
+    }
+    if (fn) fn(user, status, len);
+}
+
+} // namespace RF
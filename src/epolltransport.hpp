@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+
+#include "transport.hpp"
+#include "deadline.hpp"
+
+namespace RF {
+
+// Called from run_once() when a request finishes. status is 0 on success with len bytes
+// of reply (NUL terminated) in the caller's buffer, or a negative errno (-ETIMEDOUT,
+// -ECONNREFUSED, ...) on failure.
+typedef void (*CompletionFn)(void* user, int status, size_t len);
+
+struct TransportRequest {
+    int endpoint;           // from add_endpoint()
+    const char* data;       // request bytes, must stay valid until completion
+    size_t len;
+    char* reply;            // reply buffer, must stay valid until completion
+    size_t reply_cap;
+    Deadline deadline;      // connect + send + receive must be done by then
+    CompletionFn on_complete;
+    void* user;
+};
+
+// Single-threaded epoll event loop that owns every connect, send, receive and timeout
+// for outstanding SOAP requests. RealFlight only accepts one request per connection,
+// so each request gets its own socket which is closed once the reply is in.
+//
+// To hide connect latency each endpoint can keep a number of connections pre-opened
+// (what SocketPool used to do from its own thread); they are started and checked by
+// the loop itself.
+//
+// Not thread safe: add_endpoint, submit, run_once and exchange must all be called from
+// the thread that drives the loop. One loop can serve many simulators and many
+// requests in flight.
+class EpollTransport final : public Transport {
+public:
+    static const size_t MAX_OPS = 64;
+    static const size_t MAX_ENDPOINTS = 16;
+
+    EpollTransport();
+    ~EpollTransport();
+
+    const char* name() const override { return "epoll"; }
+
+    int add_endpoint(const char* ip, uint16_t port, size_t prewarm = 0) override;
+
+    // Queue a request. Returns false if the loop is full or the endpoint is unknown,
+    // in which case on_complete is never called.
+    bool submit(const TransportRequest& req);
+
+    // Wait up to max_wait_ms (-1: until the next deadline) for I/O, advance every
+    // outstanding request and fire completions. Returns the number completed.
+    int run_once(int max_wait_ms);
+
+    // Blocking convenience: submit one request and drive the loop until it completes.
+    // Returns the reply length, or a negative errno.
+    ssize_t exchange(int endpoint, const char* data, size_t len,
+                     char* reply, size_t reply_cap, const Deadline& deadline) override;
+
+    size_t in_flight() const { return m_in_flight; }
+
+    struct Stats {
+        uint64_t completed;
+        uint64_t failed;
+        uint64_t timed_out;
+        uint64_t prewarm_used;      // requests that started on a pre-opened connection
+        uint64_t connect_failures;
+    };
+    const Stats& stats() const { return m_stats; }
+
+private:
+    enum Phase {
+        FREE,
+        PREWARM_CONNECTING,     // pre-opened, connect still in progress
+        PREWARM_READY,          // pre-opened and connected, waiting for a request
+        CONNECTING,
+        SENDING,
+        RECEIVING
+    };
+
+    struct Op {
+        Phase phase;
+        uint32_t gen;           // bumped on reuse so stale events are ignored
+        int fd;
+        int endpoint;
+        const char* data;
+        size_t len;
+        size_t sent;
+        char* reply;
+        size_t reply_cap;
+        size_t received;
+        ReplyFramer framer;
+        int64_t deadline_ns;
+        ExchangeTimes times;
+        CompletionFn on_complete;
+        void* user;
+    };
+
+    struct Endpoint {
+        struct sockaddr_in addr;
+        size_t prewarm;
+        int64_t retry_at_ns;    // back off pre-opening after a failed connect
+    };
+
+    int m_epfd;
+    Op m_ops[MAX_OPS];
+    Endpoint m_endpoints[MAX_ENDPOINTS];
+    size_t m_num_endpoints;
+    size_t m_in_flight;
+    bool m_have_pwait2;
+    int64_t m_now;          // when the current batch of events was returned
+    Stats m_stats;
+
+    bool submit(const TransportRequest& req, int64_t now);
+    int wait_events(struct epoll_event* events, int64_t wait_ns);
+    int alloc_op();
+    int open_socket(int endpoint, bool& connected);
+    void top_up(int endpoint);
+    void handle_event(uint64_t key, uint32_t events);
+    void try_send(int idx);
+    void try_recv(int idx);
+    void watch(int idx, uint32_t events, bool add);
+    void release(int idx);
+    void complete(int idx, int status);
+};
+
+} // namespace RF
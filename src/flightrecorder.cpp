@@ -0,0 +1,305 @@
+#include <cstdio>
+#include <cerrno>
+#include <ctime>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <iostream>
+#include <chrono>
+
+#include "flightrecorder.hpp"
+#include "soapcodec.hpp"
+#include "logger.hpp"
+
+namespace RF {
+
+static const char MAGIC[8] = { 'R', 'F', 'R', 'E', 'C', 'O', 'R', 'D' };
+static const size_t PAGE = 4096;
+
+namespace {
+
+// Field table, built once from the struct layouts
+struct FieldTable {
+    RecordField fields[128];
+    uint32_t count;
+
+    void add(const char* name, size_t offset, RecordFieldType type, uint16_t n = 1) {
+        RecordField& f = fields[count++];
+        memset(&f, 0, sizeof(f));
+        snprintf(f.name, sizeof(f.name), "%s", name);
+        f.offset = (uint32_t)offset;
+        f.type = (uint16_t)type;
+        f.count = n;
+    }
+
+    FieldTable() : count(0) {
+        add("exchange", offsetof(FlightRecord, exchange), FIELD_U64);
+        add("frame_seq", offsetof(FlightRecord, frame_seq), FIELD_U64);
+        add("parsed_ns", offsetof(FlightRecord, parsed_ns), FIELD_I64);
+        add("frame_kind", offsetof(FlightRecord, frame_kind), FIELD_U32);
+        add("taken_ns", offsetof(FlightRecord, taken_ns), FIELD_I64);
+
+        size_t times = offsetof(FlightRecord, times);
+        add("times.start", times + offsetof(ExchangeTimes, start), FIELD_I64);
+        add("times.connected", times + offsetof(ExchangeTimes, connected), FIELD_I64);
+        add("times.sent", times + offsetof(ExchangeTimes, sent), FIELD_I64);
+        add("times.first_byte", times + offsetof(ExchangeTimes, first_byte), FIELD_I64);
+        add("times.done", times + offsetof(ExchangeTimes, done), FIELD_I64);
+
+        add("cmd_stamp_ns", offsetof(FlightRecord, cmd_stamp_ns), FIELD_I64);
+        add("cmd_seq", offsetof(FlightRecord, cmd_seq), FIELD_U64);
+        size_t cmd = offsetof(FlightRecord, cmd);
+        add("cmd.throttle", cmd + offsetof(RFCmd, throttle), FIELD_F64);
+        add("cmd.aileron", cmd + offsetof(RFCmd, aileron), FIELD_F64);
+        add("cmd.elevator", cmd + offsetof(RFCmd, elevator), FIELD_F64);
+        add("cmd.rudder", cmd + offsetof(RFCmd, rudder), FIELD_F64);
+        add("cmd.flaps", cmd + offsetof(RFCmd, flaps), FIELD_F64);
+        add("cmd.gear", cmd + offsetof(RFCmd, gear), FIELD_F64);
+        add("cmd.channel_mask", cmd + offsetof(RFCmd, channel_mask), FIELD_U32);
+        add("cmd.channels", cmd + offsetof(RFCmd, channels), FIELD_F64, RF_NUM_CHANNELS);
+        add("cmd.input_ns", cmd + offsetof(RFCmd, input_ns), FIELD_I64);
+
+        // State fields under their reply tags
+        size_t state = offsetof(FlightRecord, state);
+        add("rcin", state + offsetof(RFState, rcin), FIELD_F64, RF_NUM_CHANNELS);
+        for (size_t i = 0; i < NUM_STATE_FIELDS; i++) {
+            add(STATE_FIELDS[i].tag, state + STATE_FIELDS[i].offset, FIELD_F64);
+        }
+    }
+};
+
+} // namespace
+
+const RecordField* flight_record_fields(uint32_t& count) {
+    static const FieldTable table;
+    count = table.count;
+    return table.fields;
+}
+
+
+FlightRecorder::FlightRecorder()
+    : m_file_bytes(0),
+      m_keep_files(0),
+      m_sync_s(1.0),
+      m_current(nullptr),
+      m_used(0),
+      m_next(nullptr),
+      m_full(nullptr),
+      m_active(nullptr),
+      m_next_index(0),
+      m_written(0),
+      m_dropped(0),
+      m_running(false)
+{}
+
+
+FlightRecorder::~FlightRecorder() {
+    close();
+}
+
+
+std::string FlightRecorder::file_path(uint32_t index) const {
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%04u.rfrec", index);
+    return m_prefix + suffix;
+}
+
+
+bool FlightRecorder::open(const char* prefix, size_t file_bytes, uint32_t keep_files, double sync_s) {
+    close();
+    m_prefix = prefix;
+    m_keep_files = keep_files;
+    m_sync_s = sync_s;
+
+    uint32_t num_fields;
+    flight_record_fields(num_fields);
+    size_t header = (sizeof(RecordFileHeader) + num_fields * sizeof(RecordField) + PAGE - 1) / PAGE * PAGE;
+    if (file_bytes < header + sizeof(FlightRecord)) {
+        file_bytes = header + sizeof(FlightRecord);
+    }
+    m_file_bytes = file_bytes;
+
+    m_next_index = 0;
+    File* first = create_file(m_next_index++);
+    if (!first) {
+        return false;
+    }
+    m_current = first;
+    m_used = 0;
+    m_active.store(first);
+
+    m_running = true;
+    m_thread = std::thread(&FlightRecorder::run, this);
+    return true;
+}
+
+
+void FlightRecorder::close() {
+    m_running = false;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    File* full = m_full.exchange(nullptr);
+    if (full) {
+        finish_file(full, false);
+    }
+    if (m_current) {
+        finish_file(m_current, false);
+        m_current = nullptr;
+    }
+    File* next = m_next.exchange(nullptr);
+    if (next) {
+        // Prepared but never used
+        std::string path = file_path(next->index);
+        finish_file(next, true);
+        unlink(path.c_str());
+    }
+    m_active.store(nullptr);
+}
+
+
+// Background thread: a new file, sized, mapped and every page already written once
+FlightRecorder::File* FlightRecorder::create_file(uint32_t index) {
+    std::string path = file_path(index);
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        RF_LOG(LOG_ERROR, "FlightRecorder: can't create %s: %s", path.c_str(), strerror(errno));
+        return nullptr;
+    }
+
+    uint32_t num_fields;
+    const RecordField* fields = flight_record_fields(num_fields);
+    size_t header_size = (sizeof(RecordFileHeader) + num_fields * sizeof(RecordField) + PAGE - 1) / PAGE * PAGE;
+    uint64_t capacity = (m_file_bytes - header_size) / sizeof(FlightRecord);
+    size_t size = header_size + capacity * sizeof(FlightRecord);
+
+    // Reserve the blocks now so a full disk shows up here, not as SIGBUS mid-flight
+    int err = posix_fallocate(fd, 0, size);
+    if (err != 0 && ftruncate(fd, size) != 0) {
+        RF_LOG(LOG_ERROR, "FlightRecorder: can't size %s: %s", path.c_str(), strerror(err));
+        ::close(fd);
+        unlink(path.c_str());
+        return nullptr;
+    }
+
+    void* map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        RF_LOG(LOG_ERROR, "FlightRecorder: can't map %s: %s", path.c_str(), strerror(errno));
+        ::close(fd);
+        unlink(path.c_str());
+        return nullptr;
+    }
+
+    // Take the write faults here rather than on the exchange thread
+    volatile char* p = (volatile char*)map;
+    for (size_t off = 0; off < size; off += PAGE) {
+        p[off] = 0;
+    }
+
+    RecordFileHeader* h = (RecordFileHeader*)map;
+    memcpy(h->magic, MAGIC, sizeof(MAGIC));
+    h->version = RecordFileHeader::VERSION;
+    h->header_size = (uint32_t)header_size;
+    h->record_size = sizeof(FlightRecord);
+    h->num_fields = num_fields;
+    h->capacity = capacity;
+    h->records.store(0, std::memory_order_relaxed);
+    h->file_index = index;
+    h->reserved = 0;
+    struct timespec rt;
+    clock_gettime(CLOCK_REALTIME, &rt);
+    h->monotonic_ns = monotonic_ns();
+    h->realtime_ns = (int64_t)rt.tv_sec * 1000000000LL + rt.tv_nsec;
+    memcpy((char*)map + sizeof(RecordFileHeader), fields, num_fields * sizeof(RecordField));
+
+    File* f = new File;
+    f->fd = fd;
+    f->map = (char*)map;
+    f->size = size;
+    f->header = h;
+    f->records = (char*)map + header_size;
+    f->capacity = capacity;
+    f->index = index;
+    return f;
+}
+
+
+// Background thread (or close()): flush, trim to the records written and unmap
+void FlightRecorder::finish_file(File* f, bool unused) {
+    uint64_t records = f->header->records.load(std::memory_order_acquire);
+    size_t used = f->header->header_size + records * sizeof(FlightRecord);
+    if (!unused) {
+        msync(f->map, f->size, MS_SYNC);
+    }
+    munmap(f->map, f->size);
+    if (!unused && ftruncate(f->fd, used) != 0) {
+        RF_LOG(LOG_WARN, "FlightRecorder: can't trim %s: %s", file_path(f->index).c_str(), strerror(errno));
+    }
+    ::close(f->fd);
+
+    if (!unused && m_keep_files > 0 && f->index >= m_keep_files) {
+        unlink(file_path(f->index - m_keep_files).c_str());
+    }
+    delete f;
+}
+
+
+// Exchange thread: the current file is full, switch to the prepared one
+FlightRecorder::File* FlightRecorder::rotate() {
+    if (m_full.load(std::memory_order_acquire) != nullptr) {
+        return nullptr;     // the last full file isn't closed yet
+    }
+    File* next = m_next.exchange(nullptr, std::memory_order_acq_rel);
+    if (!next) {
+        return nullptr;
+    }
+    m_full.store(m_current, std::memory_order_release);
+    m_current = next;
+    m_used = 0;
+    m_active.store(next, std::memory_order_release);
+    return next;
+}
+
+
+void FlightRecorder::run() {
+    int64_t sync_ns = (int64_t)(m_sync_s * 1e9);
+    int64_t next_sync = monotonic_ns() + sync_ns;
+    File* synced_file = nullptr;
+    uint64_t synced = 0;
+
+    while (m_running) {
+        File* full = m_full.load(std::memory_order_acquire);
+        if (full) {
+            if (full == synced_file) synced_file = nullptr;
+            finish_file(full, false);
+            m_full.store(nullptr, std::memory_order_release);
+        }
+        if (!m_next.load(std::memory_order_acquire)) {
+            File* f = create_file(m_next_index);
+            if (f) {
+                m_next_index++;
+                m_next.store(f, std::memory_order_release);
+            }
+        }
+
+        // Write back what the exchange thread added since the last pass
+        File* active = m_active.load(std::memory_order_acquire);
+        if (sync_ns > 0 && active && monotonic_ns() >= next_sync) {
+            next_sync += sync_ns;
+            if (active != synced_file) {
+                synced_file = active;
+                synced = 0;
+            }
+            uint64_t records = active->header->records.load(std::memory_order_acquire);
+            if (records > synced) {
+                size_t from = (active->header->header_size + synced * sizeof(FlightRecord)) / PAGE * PAGE;
+                size_t to = active->header->header_size + records * sizeof(FlightRecord);
+                msync(active->map + from, to - from, MS_ASYNC);
+                synced = records;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+} // namespace RF
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "rfcmd.hpp"
+#include "rfstate.hpp"
+#include "transport.hpp"
+
+namespace RF {
+
+// One exchange as recorded: the parsed frame, the command that was sent for it and
+// where the time went. Fixed size, written as is.
+struct FlightRecord {
+    uint64_t exchange;          // 1 for the first recorded exchange, increments by one
+    uint64_t frame_seq;         // published frame number, 0 if the frame wasn't published
+    int64_t parsed_ns;          // monotonic_ns() when the reply was parsed
+    uint32_t frame_kind;        // FrameKind of the reply's physics time
+    uint32_t reserved;
+    int64_t taken_ns;           // command taken, 0 without RFConfig::phase_timing
+    ExchangeTimes times;        // from the transport (0: not seen)
+    int64_t cmd_stamp_ns;       // Setpoint::stamp_ns
+    uint64_t cmd_seq;           // Setpoint::seq
+    RFCmd cmd;
+    RFState state;
+};
+
+// Field descriptions in the file header, so readers need no copy of these structs
+enum RecordFieldType {
+    FIELD_F64 = 1,
+    FIELD_I64 = 2,
+    FIELD_U64 = 3,
+    FIELD_U32 = 4,
+};
+
+struct RecordField {
+    char name[48];              // e.g. "m-airspeed-MPS", "cmd.throttle", "times.sent"
+    uint32_t offset;            // in the record
+    uint16_t type;              // RecordFieldType
+    uint16_t count;             // array length (1 for scalars)
+};
+
+// Start of every recording file. Records follow at header_size, records of them
+// valid; a file cut short by a crash still has every record up to that count.
+struct RecordFileHeader {
+    static const uint32_t VERSION = 1;
+
+    char magic[8];              // "RFRECORD"
+    uint32_t version;
+    uint32_t header_size;       // page aligned
+    uint32_t record_size;
+    uint32_t num_fields;        // RecordFields right after this header
+    uint64_t capacity;          // records that fit in the file
+    std::atomic<uint64_t> records;
+    uint32_t file_index;        // 0, 1, ... as files rotate
+    uint32_t reserved;
+    int64_t realtime_ns;        // CLOCK_REALTIME and monotonic_ns() at the same
+    int64_t monotonic_ns;       // moment, to put the stamps on the calendar
+};
+
+// The field table written into every header
+const RecordField* flight_record_fields(uint32_t& count);
+
+// Appends FlightRecords to pre-allocated, pre-faulted memory-mapped files
+// "<prefix>.0000.rfrec", "<prefix>.0001.rfrec", ... of a fixed size. append() is the
+// only thing the exchange thread does: one memcpy into the mapping and a release
+// store of the count. A thread of the recorder's own creates and prefaults the next
+// file ahead of time, msyncs what has been written, and closes full files (trimmed
+// to their records). If the next file isn't ready when one fills, records are
+// dropped and counted rather than waited for.
+class FlightRecorder {
+public:
+    FlightRecorder();
+    ~FlightRecorder();
+
+    // Create the first file and start the background thread. keep_files > 0 deletes
+    // the oldest files beyond that many; sync_s is the msync period.
+    bool open(const char* prefix, size_t file_bytes, uint32_t keep_files = 0, double sync_s = 1.0);
+    void close();
+    bool is_open() const { return m_current != nullptr; }
+
+    // Exchange thread only
+    bool append(const FlightRecord& record) {
+        File* f = m_current;
+        if (m_used == f->capacity && !(f = rotate())) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        memcpy(f->records + m_used * sizeof(FlightRecord), &record, sizeof(FlightRecord));
+        m_used++;
+        f->header->records.store(m_used, std::memory_order_release);
+        m_written.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    uint64_t written() const { return m_written.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    // Path of file index
+    std::string file_path(uint32_t index) const;
+
+private:
+    struct File {
+        int fd;
+        char* map;
+        size_t size;
+        RecordFileHeader* header;
+        char* records;
+        uint64_t capacity;
+        uint32_t index;
+    };
+
+    File* create_file(uint32_t index);
+    void finish_file(File* f, bool unused);
+    File* rotate();
+    void run();
+
+    std::string m_prefix;
+    size_t m_file_bytes;
+    uint32_t m_keep_files;
+    double m_sync_s;
+
+    // Exchange thread
+    File* m_current;
+    uint64_t m_used;
+
+    // Hand-over with the background thread
+    std::atomic<File*> m_next;          // prepared, waiting to be used
+    std::atomic<File*> m_full;          // left by the exchange thread to be closed
+    std::atomic<File*> m_active;        // m_current, for msync
+    uint32_t m_next_index;              // background thread
+
+    std::atomic<uint64_t> m_written;
+    std::atomic<uint64_t> m_dropped;
+
+    std::atomic<bool> m_running;
+    std::thread m_thread;
+};
+
+} // namespace RF
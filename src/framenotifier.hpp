@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <climits>
+#include <ctime>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "deadline.hpp"
+
+namespace RF {
+
+// Wakes consumers when a new frame is published, so nobody has to poll.
+//
+// Two ways to wait:
+//   - wait_for_frame(): futex wait in the calling thread, woken directly by notify()
+//   - fd(): an eventfd that becomes readable on every frame, for epoll/poll loops.
+//     Read 8 bytes from it to re-arm. Created on first use so publishers don't pay
+//     the write() when nobody asked for it.
+//
+// notify() costs one atomic increment when nobody waits.
+class FrameNotifier {
+public:
+    FrameNotifier() : m_seq(0), m_futex(0), m_waiters(0), m_efd(-1) {}
+
+    ~FrameNotifier() {
+        int efd = m_efd.load();
+        if (efd >= 0) close(efd);
+    }
+
+    // Publisher side: seq is the frame just published
+    void notify(uint64_t seq) {
+        m_seq.store(seq);
+        m_futex.fetch_add(1);
+        if (m_waiters.load() > 0) {
+            syscall(SYS_futex, &m_futex, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+        }
+
+        int efd = m_efd.load(std::memory_order_acquire);
+        if (efd >= 0) {
+            uint64_t one = 1;
+            ssize_t ignored = write(efd, &one, sizeof(one));
+            (void)ignored;
+        }
+    }
+
+    // Block until a frame newer than seq has been published or the timeout expires.
+    // Returns the latest frame number, which is still <= seq on timeout.
+    uint64_t wait_for_frame(uint64_t seq, uint32_t timeout_ms) {
+        uint64_t latest = m_seq.load();
+        if (latest > seq) {
+            return latest;
+        }
+
+        const Deadline deadline = Deadline::after_ms(timeout_ms);
+        m_waiters.fetch_add(1);
+        for (;;) {
+            uint32_t word = m_futex.load();
+            latest = m_seq.load();
+            if (latest > seq) break;
+
+            int64_t left = deadline.remaining_ns();
+            if (left == 0) break;
+            struct timespec ts;
+            ts.tv_sec = left / 1000000000LL;
+            ts.tv_nsec = left % 1000000000LL;
+            syscall(SYS_futex, &m_futex, FUTEX_WAIT_PRIVATE, word, &ts, nullptr, 0);
+        }
+        m_waiters.fetch_sub(1);
+        return latest;
+    }
+
+    // eventfd that counts published frames. Returns -1 if it could not be created.
+    int fd() {
+        int efd = m_efd.load(std::memory_order_acquire);
+        if (efd >= 0) {
+            return efd;
+        }
+        int created = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (created < 0) {
+            return -1;
+        }
+        if (!m_efd.compare_exchange_strong(efd, created, std::memory_order_acq_rel)) {
+            close(created);     // another thread won
+            return efd;
+        }
+        return created;
+    }
+
+    uint64_t latest() const { return m_seq.load(); }
+
+private:
+    std::atomic<uint64_t> m_seq;
+    std::atomic<uint32_t> m_futex;      // bumped on every frame, the futex word
+    std::atomic<uint32_t> m_waiters;
+    std::atomic<int> m_efd;
+};
+
+} // namespace RF
@@ -2,6 +2,7 @@
 #define JOYSTICK_INTERFACE_HPP_
 
 #include <linux/input.h>
+#include <sys/ioctl.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
@@ -13,25 +14,23 @@
 #include <mutex>
 #include <chrono>
 
+#include "rfcmd.hpp"
+#include "commandslot.hpp"
+#include "rtthread.hpp"
+#include "triplebuffer.hpp"
+
 using namespace std::chrono;
 
 namespace RF {
 
-// Forward declarations for structs
-struct RFCmd {
-    double throttle;
-    double aileron;
-    double elevator; 
-    double rudder;
-    double flaps;
-    double gear;
-};
-
 
 class Joystick {
 public:
     explicit Joystick(const char* device = "/dev/input/event0") 
-    : m_dev_path(device)
+    : m_dev_path(device),
+      m_pending(neutral_cmd()),
+      m_published_seq(0),
+      m_state(neutral_setpoint())
     {
         if (openDevice()) {
             std::cout << "[SUCCESS] Joystick: Successfully opened device: " << m_dev_path << std::endl;
@@ -42,6 +41,7 @@ public:
     }
 
     ~Joystick() {
+        stop_reading();
         if (m_joystick_read_thread.joinable()) {
             m_joystick_read_thread.join();
         }
@@ -64,24 +64,54 @@ public:
     bool is_reading() {
         return m_reading.load();
     }
+
+    // Pin / prioritise the polling thread. No-op if the device never opened.
+    bool configureThread(const ThreadConfig& cfg) {
+        if (!m_joystick_read_thread.joinable()) {
+            return false;
+        }
+        return apply_thread_config(m_joystick_read_thread.native_handle(), cfg, "rf_joystick");
+    }
   
-    // Called from other threads
+    // Latest complete command (as of the last EV_SYN). Wait-free; call from one
+    // consumer thread only (the same one as takeSetpoint()).
     RF::RFCmd getJoystickVals() {
-        std::lock_guard<std::mutex> lock(m_state_mutex);
-        RFCmd new_state = m_state;
-        return new_state;
+        m_state.update();
+        return m_state.read().cmd;
+    }
+
+    // The setpoint of the newest EV_SYN, if there was one since the last call: seq
+    // counts reports, so a gap is the number of reports never taken. Wait-free - the
+    // input thread can be preempted anywhere without holding this up - and for one
+    // consumer thread only.
+    bool takeSetpoint(Setpoint& out) {
+        if (!m_state.update()) {
+            return false;
+        }
+        out = m_state.read();
+        return true;
     }
 
 private:
     const char* CLASS = "JOYSTICK";
     const char* m_dev_path; 
     int m_fd = -1;
+    bool m_monotonic_events = false;    // event timestamps are CLOCK_MONOTONIC
 
     std::atomic_bool m_reading{false};
 
-    RFCmd m_state;
+    RFCmd m_pending;                    // axes seen since the last EV_SYN, input thread only
+    uint64_t m_published_seq;           // input thread only
+    TripleBuffer<Setpoint> m_state;     // complete commands for the consumer
     std::thread m_joystick_read_thread;
-    std::mutex m_state_mutex;
+
+    static Setpoint neutral_setpoint() {
+        Setpoint sp;
+        sp.cmd = neutral_cmd();
+        sp.stamp_ns = 0;
+        sp.seq = 0;
+        return sp;
+    }
 
 
     static constexpr float AXIS_MIN = 0.0f;
@@ -92,15 +122,25 @@ private:
     bool openDevice() {
         m_fd = open(m_dev_path, O_RDONLY | O_NONBLOCK);
         if(m_fd < 0) {
-            std::cerr << "[ERROR] Joystick: Failed to open "  << m_dev_path <<
-                strerror(errno) << " \n";
+            // Running without a joystick attached is normal: one line, not an error
+            std::cerr << "[WARN] Joystick: " << m_dev_path << " not available (" <<
+                strerror(errno) << "), no joystick input\n";
             return false;
         }
+
+        // Event timestamps default to CLOCK_REALTIME; switch them to the clock every
+        // other stamp uses so they can be carried in RFCmd::input_ns
+        int clock = CLOCK_MONOTONIC;
+        m_monotonic_events = (ioctl(m_fd, EVIOCSCLOCKID, &clock) == 0);
+        if (!m_monotonic_events) {
+            std::cerr << "[WARN] Joystick: " << m_dev_path << " can't use CLOCK_MONOTONIC timestamps (" <<
+                strerror(errno) << "), input latency not measured\n";
+        }
         return true;
     }
 
 
-    bool closeDevice() {
+    void closeDevice() {
         if(m_fd >= 0) close(m_fd);
         m_fd = -1;
     }
@@ -126,19 +166,18 @@ private:
     //  Elevator/Pitch:Code 1
     //  Code 5: 3-way switch on top left
     void readAbs(int code, int value) {
-        std::lock_guard<std::mutex> lock(m_state_mutex);
         switch (code) {
             case 0:
-                m_state.aileron = normalize(value);
+                m_pending.aileron = normalize(value);
                 break;
             case 1:
-                m_state.elevator = normalize(value);
+                m_pending.elevator = normalize(value);
                 break;
             case 2:
-                m_state.throttle = normalize(value);
+                m_pending.throttle = normalize(value);
                 break;
             case 3:
-                m_state.rudder = normalize(value);
+                m_pending.rudder = normalize(value);
                 break;
             case 5:
                 // TODO: pass this disable to RFInterface
@@ -148,6 +187,28 @@ private:
     }
 
 
+    // Kernel timestamp of ev in monotonic_ns() terms, 0 if it is on another clock
+    int64_t eventTime(const struct input_event& ev) {
+        if (!m_monotonic_events) {
+            return 0;
+        }
+#ifdef input_event_sec
+        return (int64_t)ev.input_event_sec * 1000000000LL + (int64_t)ev.input_event_usec * 1000;
+#else
+        return (int64_t)ev.time.tv_sec * 1000000000LL + (int64_t)ev.time.tv_usec * 1000;
+#endif
+    }
+
+    // End of a multi-axis report: publish the complete command, never half of one
+    void publishState() {
+        Setpoint& sp = m_state.write_buffer();
+        sp.cmd = m_pending;
+        sp.stamp_ns = monotonic_ns();
+        sp.seq = ++m_published_seq;
+        m_state.publish();
+    }
+
+
 void pollForInputs() {
     std::cout << "[INFO] Joystick polling thread started" << std::endl;
     
@@ -174,6 +235,10 @@ void pollForInputs() {
         if (n == sizeof(ev)) {
             if (ev.type == EV_ABS) {
                 readAbs(ev.code, ev.value);
+            } else if (ev.type == EV_SYN && ev.code == SYN_REPORT) {
+                // The kernel stamps every event of a report with the same time
+                m_pending.input_ns = eventTime(ev);
+                publishState();
             }
         }
     }
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+namespace RF {
+
+// HDR-style log-linear histogram of durations in ns: exact below 64 ns, then 32
+// sub-buckets per power of two (about 3% resolution) up to ~18 minutes.
+//
+// One writer records without locks or RMW instructions (relaxed loads and stores
+// only); any number of readers take snapshots while it runs. A snapshot may be a
+// few records out of date but every count in it is valid.
+class LatencyHistogram {
+public:
+    static const int SUB_BITS = 5;
+    static const int SUB_COUNT = 1 << SUB_BITS;                 // 32
+    static const int LINEAR = SUB_COUNT * 2;                    // 0..63 ns exact
+    static const int MAX_MAGNITUDE = 40;                        // 2^40 ns
+    static const size_t NUM_BUCKETS = LINEAR + (MAX_MAGNITUDE - SUB_BITS) * SUB_COUNT;
+
+    struct Snapshot {
+        uint64_t counts[NUM_BUCKETS];
+        uint64_t count;
+        uint64_t sum_ns;
+        int64_t max_ns;
+
+        // Value at percentile p (0..100), as the upper bound of its bucket
+        int64_t percentile(double p) const;
+        double mean_ns() const { return count ? (double)sum_ns / count : 0.0; }
+
+        // this -= earlier, for the activity between two snapshots. max_ns becomes the
+        // interval's max to bucket resolution (about 3%).
+        void subtract(const Snapshot& earlier);
+    };
+
+    LatencyHistogram() { reset(); }
+
+    // Writer only
+    void record(int64_t ns) {
+        if (ns < 0) ns = 0;
+        size_t idx = bucket(ns);
+        m_counts[idx].store(m_counts[idx].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        m_sum.store(m_sum.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+        if (ns > m_max.load(std::memory_order_relaxed)) {
+            m_max.store(ns, std::memory_order_relaxed);
+        }
+        m_count.store(m_count.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Writer only (or while nothing records)
+    void reset() {
+        for (size_t i = 0; i < NUM_BUCKETS; i++) {
+            m_counts[i].store(0, std::memory_order_relaxed);
+        }
+        m_sum.store(0, std::memory_order_relaxed);
+        m_max.store(0, std::memory_order_relaxed);
+        m_count.store(0, std::memory_order_release);
+    }
+
+    // Any thread
+    void snapshot(Snapshot& out) const {
+        out.count = m_count.load(std::memory_order_acquire);
+        out.sum_ns = m_sum.load(std::memory_order_relaxed);
+        out.max_ns = m_max.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < NUM_BUCKETS; i++) {
+            out.counts[i] = m_counts[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+
+    static size_t bucket(int64_t ns) {
+        uint64_t v = (uint64_t)ns;
+        if (v < (uint64_t)LINEAR) {
+            return (size_t)v;
+        }
+        int magnitude = 63 - __builtin_clzll(v);                // >= SUB_BITS + 1
+        if (magnitude >= MAX_MAGNITUDE) {
+            return NUM_BUCKETS - 1;
+        }
+        size_t sub = (size_t)(v >> (magnitude - SUB_BITS)) & (SUB_COUNT - 1);
+        return LINEAR + (size_t)(magnitude - SUB_BITS - 1) * SUB_COUNT + sub;
+    }
+
+    // Largest value that lands in bucket idx
+    static int64_t bucket_upper(size_t idx) {
+        if (idx < (size_t)LINEAR) {
+            return (int64_t)idx;
+        }
+        size_t rel = idx - LINEAR;
+        int magnitude = (int)(rel / SUB_COUNT) + SUB_BITS + 1;
+        uint64_t sub = rel % SUB_COUNT;
+        uint64_t lower = ((uint64_t)SUB_COUNT | sub) << (magnitude - SUB_BITS);
+        return (int64_t)(lower + (1ULL << (magnitude - SUB_BITS)) - 1);
+    }
+
+private:
+    std::atomic<uint64_t> m_counts[NUM_BUCKETS];
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_sum;
+    std::atomic<int64_t> m_max;
+};
+
+
+inline int64_t LatencyHistogram::Snapshot::percentile(double p) const {
+    uint64_t total = 0;
+    for (size_t i = 0; i < NUM_BUCKETS; i++) {
+        total += counts[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(p / 100.0 * total + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > total) rank = total;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < NUM_BUCKETS; i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            int64_t upper = bucket_upper(i);
+            return (max_ns > 0 && upper > max_ns) ? max_ns : upper;
+        }
+    }
+    return max_ns;
+}
+
+
+inline void LatencyHistogram::Snapshot::subtract(const Snapshot& earlier) {
+    for (size_t i = 0; i < NUM_BUCKETS; i++) {
+        counts[i] -= earlier.counts[i];
+    }
+    count -= earlier.count;
+    sum_ns -= earlier.sum_ns;
+    // The running max can't be un-merged: take the interval's top bucket instead,
+    // capped by the running max so it is exact when the max fell in this interval
+    int64_t top = 0;
+    for (size_t i = NUM_BUCKETS; i-- > 0; ) {
+        if (counts[i]) {
+            top = bucket_upper(i);
+            break;
+        }
+    }
+    max_ns = top < max_ns ? top : max_ns;
+}
+
+} // namespace RF
@@ -0,0 +1,206 @@
+#include <cstdio>
+#include <cstdarg>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <chrono>
+
+#include "logger.hpp"
+#include "rfcmd.hpp"
+
+namespace RF {
+
+const char* log_level_name(LogLevel level) {
+    switch (level) {
+        case LOG_DEBUG: return "[DEBUG]";
+        case LOG_INFO:  return "[INFO]";
+        case LOG_WARN:  return "[WARN]";
+        case LOG_ERROR: return "[ERROR]";
+        default:        return "[?]";
+    }
+}
+
+
+Logger& Logger::instance() {
+    static Logger logger;
+    return logger;
+}
+
+
+Logger::Logger()
+    : m_enqueue(0),
+      m_dequeue(0),
+      m_level(LOG_INFO),
+      m_fd(STDERR_FILENO),
+      m_interval_ns(0),
+      m_burst_ns(0),
+      m_written(0),
+      m_suppressed(0),
+      m_dropped(0),
+      m_running(true)
+{
+    for (size_t i = 0; i < QUEUE_SIZE; i++) {
+        m_slots[i].seq.store(i, std::memory_order_relaxed);
+        m_slots[i].len = 0;
+    }
+    set_rate_limit(5, 1000);
+    m_thread = std::thread(&Logger::run, this);
+}
+
+
+Logger::~Logger() {
+    m_running = false;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+
+void Logger::set_rate_limit(uint32_t burst, uint32_t interval_ms) {
+    int64_t interval = (int64_t)interval_ms * 1000000;
+    m_interval_ns.store(interval, std::memory_order_relaxed);
+    m_burst_ns.store((burst > 0 ? burst - 1 : 0) * interval, std::memory_order_relaxed);
+}
+
+
+// Generic cell rate algorithm: one CAS on the site, no clock besides now
+bool Logger::allow(LogSite& site, int64_t now) {
+    int64_t interval = m_interval_ns.load(std::memory_order_relaxed);
+    int64_t tolerance = m_burst_ns.load(std::memory_order_relaxed);
+    int64_t tat = site.tat_ns.load(std::memory_order_relaxed);
+    for (;;) {
+        int64_t t = tat > now ? tat : now;
+        if (t - now > tolerance) {
+            return false;
+        }
+        if (site.tat_ns.compare_exchange_weak(tat, t + interval, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+
+void Logger::log(LogSite& site, LogLevel level, const char* fmt, ...) {
+    if (!enabled(level)) {
+        return;
+    }
+    if (!allow(site, monotonic_ns())) {
+        site.suppressed.fetch_add(1, std::memory_order_relaxed);
+        m_suppressed.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    char text[sizeof(Slot::text)];
+    int n = snprintf(text, MAX_LINE + 1, "%s ", log_level_name(level));
+
+    va_list args;
+    va_start(args, fmt);
+    int m = vsnprintf(text + n, MAX_LINE + 1 - n, fmt, args);
+    va_end(args);
+    size_t len = (m < 0) ? n : (size_t)n + m;
+    if (len > MAX_LINE) len = MAX_LINE;
+
+    uint64_t held = site.suppressed.exchange(0, std::memory_order_relaxed);
+    if (held) {
+        len += snprintf(text + len, sizeof(text) - len - 1, " (%llu similar suppressed)", (unsigned long long)held);
+    }
+    text[len++] = '\n';
+
+    if (!push(text, len)) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+
+// Bounded multi-producer queue (Vyukov): a slot is free for position pos when its
+// seq is pos, and holds a line for the writer when it is pos + 1
+bool Logger::push(const char* text, size_t len) {
+    uint64_t pos = m_enqueue.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+        slot = &m_slots[pos & (QUEUE_SIZE - 1)];
+        uint64_t seq = slot->seq.load(std::memory_order_acquire);
+        int64_t diff = (int64_t)(seq - pos);
+        if (diff == 0) {
+            if (m_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;       // full: the writer is a whole queue behind
+        } else {
+            pos = m_enqueue.load(std::memory_order_relaxed);
+        }
+    }
+    memcpy(slot->text, text, len);
+    slot->len = (uint32_t)len;
+    slot->seq.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+
+static void write_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+
+// Writer thread: write out every published line, batched into few write()s
+size_t Logger::drain() {
+    char batch[16384];
+    size_t batch_len = 0;
+    size_t lines = 0;
+    uint64_t pos = m_dequeue.load(std::memory_order_relaxed);
+    int fd = m_fd.load(std::memory_order_relaxed);
+
+    for (;;) {
+        Slot& slot = m_slots[pos & (QUEUE_SIZE - 1)];
+        if (slot.seq.load(std::memory_order_acquire) != pos + 1) {
+            break;
+        }
+        if (batch_len + slot.len > sizeof(batch)) {
+            write_all(fd, batch, batch_len);
+            batch_len = 0;
+        }
+        memcpy(batch + batch_len, slot.text, slot.len);
+        batch_len += slot.len;
+        slot.seq.store(pos + QUEUE_SIZE, std::memory_order_release);
+        pos++;
+        lines++;
+    }
+    if (batch_len) {
+        write_all(fd, batch, batch_len);
+    }
+    m_written.fetch_add(lines, std::memory_order_relaxed);
+    m_dequeue.store(pos, std::memory_order_release);
+    return lines;
+}
+
+
+void Logger::run() {
+    for (;;) {
+        bool running = m_running.load();
+        if (drain() == 0) {
+            if (!running) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    }
+}
+
+
+void Logger::flush() {
+    uint64_t target = m_enqueue.load(std::memory_order_acquire);
+    while (m_dequeue.load(std::memory_order_acquire) < target && m_running.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+} // namespace RF
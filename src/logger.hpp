@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <thread>
+
+namespace RF {
+
+enum LogLevel {
+    LOG_DEBUG,
+    LOG_INFO,
+    LOG_WARN,
+    LOG_ERROR,
+    LOG_OFF,            // as a threshold: log nothing
+};
+
+// Rate-limit state of one logging call site (a static inside RF_LOG). Allows a burst
+// of messages, then one per interval; the rest are counted and reported with the
+// next message that gets through.
+struct LogSite {
+    std::atomic<int64_t> tat_ns;        // theoretical arrival time (GCRA)
+    std::atomic<uint64_t> suppressed;   // since the last message that got through
+
+    LogSite() : tat_ns(0), suppressed(0) {}
+};
+
+// Asynchronous logger for the control path. log() formats the line on the caller's
+// stack, copies it into a lock-free bounded queue and returns - no locks, syscalls or
+// allocations - and a background thread writes the lines out. A failing simulator
+// can make every exchange log; the rate limit per call site and the fixed-size queue
+// (lines are dropped and counted when it is full) keep that from ever slowing the
+// exchange loop.
+//
+// Use through RF_LOG(level, fmt, ...), which adds the "[ERROR] " style prefix.
+class Logger {
+public:
+    static const size_t QUEUE_SIZE = 1024;      // power of two
+    static const size_t MAX_LINE = 240;         // longer lines are truncated
+
+    // The process-wide logger; its thread starts on first use
+    static Logger& instance();
+
+    // Messages below level are discarded before formatting (default LOG_INFO)
+    void set_level(LogLevel level) { m_level.store(level, std::memory_order_relaxed); }
+    LogLevel level() const { return (LogLevel)m_level.load(std::memory_order_relaxed); }
+    bool enabled(LogLevel level) const { return level >= m_level.load(std::memory_order_relaxed); }
+
+    // Per call site: burst messages, then one every interval_ms (defaults 5, 1000)
+    void set_rate_limit(uint32_t burst, uint32_t interval_ms);
+
+    // Where lines go (default stderr)
+    void set_fd(int fd) { m_fd.store(fd, std::memory_order_relaxed); }
+
+    // printf-style. Thread safe, never blocks.
+    void log(LogSite& site, LogLevel level, const char* fmt, ...) __attribute__((format(printf, 4, 5)));
+
+    // Block until everything logged so far has been written
+    void flush();
+
+    // Totals: lines written, lines held back by the rate limit, lines lost to a full
+    // queue
+    uint64_t written() const { return m_written.load(std::memory_order_relaxed); }
+    uint64_t suppressed() const { return m_suppressed.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    ~Logger();
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> seq;
+        uint32_t len;
+        char text[MAX_LINE + 64];   // line, rate-limit note and newline
+    };
+
+    Logger();
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    bool allow(LogSite& site, int64_t now);
+    bool push(const char* text, size_t len);
+    size_t drain();
+    void run();
+
+    Slot m_slots[QUEUE_SIZE];
+    alignas(64) std::atomic<uint64_t> m_enqueue;
+    alignas(64) std::atomic<uint64_t> m_dequeue;    // advanced by the writer thread only
+
+    std::atomic<int> m_level;
+    std::atomic<int> m_fd;
+    std::atomic<int64_t> m_interval_ns;
+    std::atomic<int64_t> m_burst_ns;            // (burst - 1) * interval
+
+    std::atomic<uint64_t> m_written;
+    std::atomic<uint64_t> m_suppressed;
+    std::atomic<uint64_t> m_dropped;
+
+    std::atomic<bool> m_running;
+    std::thread m_thread;
+};
+
+const char* log_level_name(LogLevel level);
+
+} // namespace RF
+
+// Log through a rate-limited call site of its own: RF_LOG(RF::LOG_ERROR, "X: %s", why)
+#define RF_LOG(level, ...)                                                  \
+    do {                                                                    \
+        ::RF::Logger& rf_logger_ = ::RF::Logger::instance();                \
+        if (rf_logger_.enabled(level)) {                                    \
+            static ::RF::LogSite rf_log_site_;                              \
+            rf_logger_.log(rf_log_site_, level, __VA_ARGS__);               \
+        }                                                                   \
+    } while (0)
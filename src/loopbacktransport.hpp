@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cerrno>
+#include <utility>
+#include <sys/types.h>
+
+#include "transport.hpp"
+#include "deadline.hpp"
+#include "rfcmd.hpp"
+
+namespace RF {
+
+// In-process transport: every exchange is a direct call into Handler, with no sockets
+// or syscalls, so the request building and reply parsing can be benchmarked on their
+// own. Handler needs
+//
+//   // Handle one complete request. Write at most reply_cap - 1 bytes of HTTP reply
+//   // and return its length, or a negative errno to fail the exchange.
+//   ssize_t handle(int endpoint, const char* request, size_t len, char* reply, size_t reply_cap);
+//
+template <class Handler>
+class LoopbackTransport final : public Transport {
+public:
+    static const size_t MAX_ENDPOINTS = 16;
+
+    template <class... HandlerArgs>
+    explicit LoopbackTransport(HandlerArgs&&... handler_args)
+        : m_handler(std::forward<HandlerArgs>(handler_args)...),
+          m_num_endpoints(0)
+    {}
+
+    const char* name() const override { return "loopback"; }
+
+    int add_endpoint(const char*, uint16_t, size_t) override {
+        if (m_num_endpoints >= MAX_ENDPOINTS) {
+            return -1;
+        }
+        return (int)m_num_endpoints++;
+    }
+
+    ssize_t exchange(int endpoint, const char* data, size_t len,
+                     char* reply, size_t reply_cap, const Deadline& deadline) override {
+        m_exchanges++;
+        m_times.start = monotonic_ns();
+        m_times.connected = m_times.sent = m_times.first_byte = 0;
+        m_times.done = m_times.start;
+        if (endpoint < 0 || (size_t)endpoint >= m_num_endpoints || reply_cap == 0) {
+            return -EINVAL;
+        }
+        if (deadline.at_ns <= m_times.start) {
+            return -ETIMEDOUT;
+        }
+
+        ssize_t n = m_handler.handle(endpoint, data, len, reply, reply_cap);
+        m_times.done = monotonic_ns();
+        if (n < 0) {
+            return n;
+        }
+        if ((size_t)n >= reply_cap) {
+            return -EMSGSIZE;
+        }
+        reply[n] = '\0';
+        return n;
+    }
+
+    Handler& handler() { return m_handler; }
+
+private:
+    Handler m_handler;
+    size_t m_num_endpoints;
+};
+
+} // namespace RF
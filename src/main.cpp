@@ -23,8 +23,10 @@ int main(int argc, char* argv[]) {
     // Create RF interface with Joystick 
     RFInterface sim("172.19.112.1", 18083);
     
+    // Wake on every new telemetry frame; the timeout keeps the loop responsive to signals
+    uint64_t seq = 0;
     while (running) {              
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        seq = sim.wait_for_frame(seq, 100);
     }
 
     return 0;
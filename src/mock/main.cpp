@@ -0,0 +1,85 @@
+// rf_mock: stand-in for RealFlight Link on the local machine, for CI and benchmarks
+//
+//   rf_mock [--ip A] [--port N] [--latency-us N] [--jitter-us N] [--drop P] [--error P]
+//           [--stall P] [--truncate P] [--step S] [--physics-hz N] [--seed N]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <iostream>
+
+#include "mocksim.hpp"
+#include "mockserver.hpp"
+
+using namespace RF;
+
+static volatile sig_atomic_t running = 1;
+
+static void signal_handler(int) {
+    running = 0;
+}
+
+static void usage() {
+    std::cerr << "usage: rf_mock [--ip A] [--port N] [--latency-us N] [--jitter-us N]\n"
+                 "               [--drop P] [--error P] [--stall P] [--truncate P]\n"
+                 "               [--step S] [--physics-hz N] [--seed N]\n";
+}
+
+int main(int argc, char* argv[]) {
+    MockConfig config;
+    const char* ip = "127.0.0.1";
+    uint16_t port = 18083;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (i + 1 >= argc) {
+            usage();
+            return 1;
+        }
+        const char* value = argv[++i];
+        if (!strcmp(arg, "--ip")) ip = value;
+        else if (!strcmp(arg, "--port")) port = (uint16_t)atoi(value);
+        else if (!strcmp(arg, "--latency-us")) config.latency_us = strtoul(value, nullptr, 10);
+        else if (!strcmp(arg, "--jitter-us")) config.jitter_us = strtoul(value, nullptr, 10);
+        else if (!strcmp(arg, "--drop")) config.drop_rate = atof(value);
+        else if (!strcmp(arg, "--error")) config.error_rate = atof(value);
+        else if (!strcmp(arg, "--stall")) config.stall_rate = atof(value);
+        else if (!strcmp(arg, "--truncate")) config.truncate_rate = atof(value);
+        else if (!strcmp(arg, "--step")) config.step_s = atof(value);
+        else if (!strcmp(arg, "--physics-hz")) config.physics_hz = atof(value);
+        else if (!strcmp(arg, "--seed")) config.seed = strtoul(value, nullptr, 10);
+        else {
+            usage();
+            return 1;
+        }
+    }
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    MockSim sim(config);
+    MockServer server(sim);
+    if (!server.listen(ip, port)) {
+        return 1;
+    }
+    std::cout << "[INFO] rf_mock: listening on " << ip << ":" << server.port() << std::endl;
+
+    while (running) {
+        server.run_once(100);
+    }
+
+    MockSim::Stats s = sim.stats();
+    MockServer::Stats n = server.stats();
+    printf("{\"requests\":%llu,\"exchanges\":%llu,\"injects\":%llu,\"restores\":%llu,\"resets\":%llu,"
+           "\"bad_requests\":%llu,\"faults\":%llu,\"connections\":%llu,\"replied\":%llu,"
+           "\"dropped\":%llu,\"stalled\":%llu,\"truncated\":%llu,\"extra_requests\":%llu}\n",
+           (unsigned long long)s.requests, (unsigned long long)s.exchanges,
+           (unsigned long long)s.injects, (unsigned long long)s.restores,
+           (unsigned long long)s.resets, (unsigned long long)s.bad_requests,
+           (unsigned long long)s.faults, (unsigned long long)n.accepted,
+           (unsigned long long)n.replied, (unsigned long long)n.dropped,
+           (unsigned long long)n.stalled, (unsigned long long)n.truncated,
+           (unsigned long long)n.extra_requests);
+    return 0;
+}
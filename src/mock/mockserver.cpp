@@ -0,0 +1,367 @@
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include <iostream>
+
+#include "mockserver.hpp"
+
+namespace RF {
+
+static const uint32_t LISTEN_INDEX = UINT32_MAX;
+static const size_t MAX_EVENTS = 64;
+
+static uint64_t event_data(uint32_t index, uint32_t gen) {
+    return ((uint64_t)gen << 32) | index;
+}
+
+
+MockServer::MockServer(MockSim& sim)
+    : m_sim(sim),
+      m_epfd(-1),
+      m_listen_fd(-1),
+      m_port(0),
+      m_have_pwait2(true),
+      m_conns(MAX_CONNECTIONS),
+      m_running(false)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+    for (size_t i = 0; i < MAX_CONNECTIONS; i++) {
+        m_conns[i].fd = -1;
+        m_conns[i].gen = 0;
+        m_conns[i].phase = FREE;
+    }
+    m_epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epfd < 0) {
+        std::cerr << "[ERROR] MockServer: epoll_create1 failed: " << strerror(errno) << std::endl;
+    }
+}
+
+
+MockServer::~MockServer() {
+    stop();
+    for (size_t i = 0; i < MAX_CONNECTIONS; i++) {
+        if (m_conns[i].phase != FREE) {
+            close_conn(i);
+        }
+    }
+    if (m_listen_fd >= 0) close(m_listen_fd);
+    if (m_epfd >= 0) close(m_epfd);
+}
+
+
+bool MockServer::listen(const char* ip, uint16_t port) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, ip, &addr.sin_addr) <= 0) {
+        std::cerr << "[ERROR] MockServer: bad address " << ip << std::endl;
+        return false;
+    }
+
+    m_listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_listen_fd < 0) {
+        std::cerr << "[ERROR] MockServer: socket failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+    int one = 1;
+    setsockopt(m_listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(m_listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        ::listen(m_listen_fd, 128) < 0) {
+        std::cerr << "[ERROR] MockServer: can't listen on " << ip << ":" << port << ": "
+                  << strerror(errno) << std::endl;
+        close(m_listen_fd);
+        m_listen_fd = -1;
+        return false;
+    }
+
+    socklen_t len = sizeof(addr);
+    getsockname(m_listen_fd, (struct sockaddr*)&addr, &len);
+    m_port = ntohs(addr.sin_port);
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = event_data(LISTEN_INDEX, 0);
+    return epoll_ctl(m_epfd, EPOLL_CTL_ADD, m_listen_fd, &ev) == 0;
+}
+
+
+bool MockServer::start() {
+    if (m_listen_fd < 0 || m_running) {
+        return false;
+    }
+    m_running = true;
+    m_thread = std::thread([this]() {
+        while (m_running) {
+            run_once(50);
+        }
+    });
+    return true;
+}
+
+
+void MockServer::stop() {
+    m_running = false;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+
+int MockServer::run_once(int max_wait_ms) {
+    uint64_t replied_before = m_stats.replied;
+
+    // Sleep until the next delayed reply at the latest
+    int64_t now = monotonic_ns();
+    int64_t wait_ns = max_wait_ms < 0 ? -1 : (int64_t)max_wait_ms * 1000000;
+    for (size_t i = 0; i < MAX_CONNECTIONS; i++) {
+        if (m_conns[i].phase == DELAYED) {
+            int64_t until = m_conns[i].reply_at_ns - now;
+            if (until < 0) until = 0;
+            if (wait_ns < 0 || until < wait_ns) wait_ns = until;
+        }
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    int n = wait_events(events, wait_ns);
+    if (n < 0 && errno != EINTR) {
+        std::cerr << "[ERROR] MockServer: epoll_wait failed: " << strerror(errno) << std::endl;
+    }
+    for (int i = 0; i < n; i++) {
+        handle_event(events[i].data.u64, events[i].events);
+    }
+
+    now = monotonic_ns();
+    for (size_t i = 0; i < MAX_CONNECTIONS; i++) {
+        if (m_conns[i].phase == DELAYED && m_conns[i].reply_at_ns <= now) {
+            send_reply(i);
+        }
+    }
+
+    return (int)(m_stats.replied - replied_before);
+}
+
+
+int MockServer::wait_events(struct epoll_event* events, int64_t wait_ns) {
+#ifdef __NR_epoll_pwait2
+    if (m_have_pwait2) {
+        struct timespec ts;
+        ts.tv_sec = wait_ns / 1000000000LL;
+        ts.tv_nsec = wait_ns % 1000000000LL;
+        int n = (int)syscall(__NR_epoll_pwait2, m_epfd, events, (int)MAX_EVENTS,
+                             wait_ns < 0 ? nullptr : &ts, nullptr, 0);
+        if (n >= 0 || errno != ENOSYS) {
+            return n;
+        }
+        m_have_pwait2 = false;
+    }
+#endif
+    int timeout_ms = (wait_ns < 0) ? -1 : (int)((wait_ns + 999999) / 1000000);
+    return epoll_wait(m_epfd, events, MAX_EVENTS, timeout_ms);
+}
+
+
+void MockServer::handle_event(uint64_t data, uint32_t events) {
+    uint32_t index = (uint32_t)data;
+    if (index == LISTEN_INDEX) {
+        accept_all();
+        return;
+    }
+    if (index >= MAX_CONNECTIONS || m_conns[index].gen != (uint32_t)(data >> 32) ||
+        m_conns[index].phase == FREE) {
+        return;     // stale event for a closed connection
+    }
+
+    if (events & EPOLLIN) {
+        on_readable(index);
+    }
+    if ((events & EPOLLOUT) && m_conns[index].phase == WRITING) {
+        write_out(index);
+    }
+    if ((events & (EPOLLERR | EPOLLHUP)) && m_conns[index].phase != FREE) {
+        close_conn(index);
+    }
+}
+
+
+void MockServer::accept_all() {
+    for (;;) {
+        int fd = accept4(m_listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+
+        size_t i = 0;
+        while (i < MAX_CONNECTIONS && m_conns[i].phase != FREE) i++;
+        if (i == MAX_CONNECTIONS) {
+            m_stats.rejected++;
+            close(fd);
+            continue;
+        }
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        Conn& c = m_conns[i];
+        c.fd = fd;
+        c.gen++;
+        c.phase = READING;
+        c.fault = MockSim::FAULT_NONE;
+        c.received = 0;
+        c.framer.reset();
+        c.reply_len = 0;
+        c.sent = 0;
+        c.in[0] = '\0';
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u64 = event_data(i, c.gen);
+        epoll_ctl(m_epfd, EPOLL_CTL_ADD, fd, &ev);
+        m_stats.accepted++;
+    }
+}
+
+
+void MockServer::on_readable(size_t i) {
+    Conn& c = m_conns[i];
+    for (;;) {
+        char scratch[512];
+        bool reading = (c.phase == READING);
+        char* dst = reading ? c.in + c.received : scratch;
+        size_t room = reading ? REQUEST_CAP - 1 - c.received : sizeof(scratch);
+        if (room == 0) {
+            m_stats.oversized++;
+            close_conn(i);
+            return;
+        }
+
+        ssize_t n = recv(c.fd, dst, room, 0);
+        if (n == 0) {
+            close_conn(i);      // client gave up or closed early
+            return;
+        }
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                close_conn(i);
+            }
+            return;
+        }
+
+        if (!reading) {
+            // One request per connection: anything more is never answered
+            m_stats.extra_requests++;
+            continue;
+        }
+
+        size_t prev = c.received;
+        c.received += n;
+        c.in[c.received] = '\0';
+        if (c.framer.complete(c.in, c.received, prev)) {
+            if (c.framer.content_len != SIZE_MAX &&
+                c.received > c.framer.header_len + c.framer.content_len) {
+                m_stats.extra_requests++;
+            }
+            on_request(i);
+            if (c.phase == FREE) {
+                return;
+            }
+        }
+    }
+}
+
+
+void MockServer::on_request(size_t i) {
+    Conn& c = m_conns[i];
+    c.fault = m_sim.next_fault();
+    switch (c.fault) {
+        case MockSim::FAULT_DROP:
+            m_stats.dropped++;
+            close_conn(i);
+            return;
+        case MockSim::FAULT_STALL:
+            m_stats.stalled++;
+            c.phase = STALLED;
+            return;
+        default:
+            break;
+    }
+
+    int64_t delay_ns = m_sim.next_delay_ns();
+    c.phase = DELAYED;
+    c.reply_at_ns = monotonic_ns() + delay_ns;
+    if (delay_ns == 0) {
+        send_reply(i);
+    }
+}
+
+
+// The reply is built when it goes out, so physics time is that of the reply
+void MockServer::send_reply(size_t i) {
+    Conn& c = m_conns[i];
+    ssize_t n = (c.fault == MockSim::FAULT_ERROR)
+        ? m_sim.error_reply(c.out, REPLY_CAP)
+        : m_sim.respond(c.in, c.received, c.out, REPLY_CAP);
+    if (n <= 0) {
+        close_conn(i);
+        return;
+    }
+
+    c.reply_len = n;
+    if (c.fault == MockSim::FAULT_TRUNCATE) {
+        m_stats.truncated++;
+        c.reply_len = n / 2;
+    }
+    c.sent = 0;
+    c.phase = WRITING;
+    write_out(i);
+}
+
+
+void MockServer::write_out(size_t i) {
+    Conn& c = m_conns[i];
+    while (c.sent < c.reply_len) {
+        ssize_t n = send(c.fd, c.out + c.sent, c.reply_len - c.sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                set_events(i, EPOLLIN | EPOLLOUT);
+                return;
+            }
+            close_conn(i);
+            return;
+        }
+        c.sent += n;
+    }
+
+    if (c.fault != MockSim::FAULT_TRUNCATE) {
+        m_stats.replied++;
+    }
+    close_conn(i);
+}
+
+
+void MockServer::set_events(size_t i, uint32_t events) {
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.u64 = event_data(i, m_conns[i].gen);
+    epoll_ctl(m_epfd, EPOLL_CTL_MOD, m_conns[i].fd, &ev);
+}
+
+
+void MockServer::close_conn(size_t i) {
+    Conn& c = m_conns[i];
+    if (c.fd >= 0) {
+        epoll_ctl(m_epfd, EPOLL_CTL_DEL, c.fd, nullptr);
+        close(c.fd);
+    }
+    c.fd = -1;
+    c.phase = FREE;
+}
+
+} // namespace RF
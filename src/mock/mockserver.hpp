@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <sys/epoll.h>
+
+#include "mocksim.hpp"
+#include "src/transport.hpp"
+
+namespace RF {
+
+// TCP front end for MockSim, speaking RealFlight's SOAP-over-HTTP: one request per
+// connection, closed once the reply is sent. Applies the simulator's latency, jitter
+// and faults per request. Single threaded epoll loop, either driven with run_once()
+// or on its own thread with start().
+class MockServer {
+public:
+    static const size_t MAX_CONNECTIONS = 64;
+    static const size_t REQUEST_CAP = 8192;
+    static const size_t REPLY_CAP = 16384;
+
+    struct Stats {
+        uint64_t accepted;
+        uint64_t rejected;      // over MAX_CONNECTIONS, closed straight away
+        uint64_t replied;
+        uint64_t dropped;
+        uint64_t stalled;
+        uint64_t truncated;
+        uint64_t extra_requests;    // bytes after the first request on a connection
+        uint64_t oversized;         // requests over REQUEST_CAP
+    };
+
+    explicit MockServer(MockSim& sim);
+    ~MockServer();
+
+    // Listen on ip:port; port 0 picks a free one, see port()
+    bool listen(const char* ip, uint16_t port);
+    uint16_t port() const { return m_port; }
+
+    // Wait up to max_wait_ms (-1: until the next delayed reply is due) for I/O and
+    // send every reply that is due. Returns the number of replies sent.
+    int run_once(int max_wait_ms);
+
+    // Run the loop on a thread of its own until stop()
+    bool start();
+    void stop();
+
+    Stats stats() const { return m_stats; }
+
+private:
+    enum Phase {
+        FREE,
+        READING,
+        DELAYED,    // request in, reply due at reply_at_ns
+        WRITING,
+        STALLED     // injected stall: wait for the client to give up
+    };
+
+    struct Conn {
+        int fd;
+        uint32_t gen;
+        Phase phase;
+        MockSim::Fault fault;
+        size_t received;
+        ReplyFramer framer;     // requests are framed like replies: Content-Length
+        int64_t reply_at_ns;
+        size_t reply_len;
+        size_t sent;
+        char in[REQUEST_CAP];
+        char out[REPLY_CAP];
+    };
+
+    void accept_all();
+    void handle_event(uint64_t data, uint32_t events);
+    void on_readable(size_t i);
+    void on_request(size_t i);
+    void send_reply(size_t i);
+    void write_out(size_t i);
+    void close_conn(size_t i);
+    void set_events(size_t i, uint32_t events);
+    int wait_events(struct epoll_event* events, int64_t wait_ns);
+
+    MockSim& m_sim;
+    int m_epfd;
+    int m_listen_fd;
+    uint16_t m_port;
+    bool m_have_pwait2;
+    std::vector<Conn> m_conns;
+    Stats m_stats;
+
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+};
+
+} // namespace RF
@@ -0,0 +1,442 @@
+#include <cstring>
+#include <cstdio>
+#include <cstdarg>
+#include <cstdlib>
+#include <cmath>
+#include <cerrno>
+#include <ctime>
+
+#include "mocksim.hpp"
+#include "src/replaytransport.hpp"
+
+namespace RF {
+
+namespace {
+
+const double DEG = M_PI / 180.0;
+const double GROUND_ASL_MTR = 100.0;
+const double BATTERY_MAH = 2200.0;
+
+// Appends formatted text to a fixed buffer, remembering if it ever overflowed
+struct Writer {
+    char* buf;
+    size_t cap;
+    size_t len;
+    bool overflow;
+
+    Writer(char* b, size_t c) : buf(b), cap(c), len(0), overflow(false) {}
+
+    void add(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+        if (overflow) return;
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(buf + len, cap - len, fmt, args);
+        va_end(args);
+        if (n < 0 || (size_t)n >= cap - len) {
+            overflow = true;
+            return;
+        }
+        len += n;
+    }
+
+    void number(const char* tag, double value) { add("<%s>%.6f</%s>", tag, value, tag); }
+    void flag(const char* tag, bool value) { add("<%s>%s</%s>", tag, value ? "true" : "false", tag); }
+};
+
+const char ENVELOPE_OPEN[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+    "<SOAP-ENV:Envelope xmlns:SOAP-ENV=\"http://schemas.xmlsoap.org/soap/envelope/\" "
+    "xmlns:SOAP-ENC=\"http://schemas.xmlsoap.org/soap/encoding/\" "
+    "xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" "
+    "xmlns:xsd=\"http://www.w3.org/2001/XMLSchema\">"
+    "<SOAP-ENV:Body>";
+const char ENVELOPE_CLOSE[] = "</SOAP-ENV:Body></SOAP-ENV:Envelope>";
+
+// Put the HTTP header in front of the body written at reply + header room
+ssize_t finish_http(const char* status, char* reply, size_t reply_cap, size_t header_room, size_t body_len) {
+    char header[160];
+    int n = snprintf(header, sizeof(header),
+                     "HTTP/1.1 %s\r\nServer: gSOAP/2.7\r\nContent-Type: text/xml; charset=utf-8\r\n"
+                     "Content-Length: %zu\r\nConnection: close\r\n\r\n", status, body_len);
+    if (n < 0 || (size_t)n > header_room || (size_t)n + body_len >= reply_cap) {
+        return -EMSGSIZE;
+    }
+    memmove(reply + n, reply + header_room, body_len);
+    memcpy(reply, header, n);
+    reply[n + body_len] = '\0';
+    return n + body_len;
+}
+
+const size_t HEADER_ROOM = 160;
+
+} // namespace
+
+
+MockSim::MockSim(const MockConfig& config)
+    : m_config(config),
+      m_rng(config.seed),
+      m_injected(false),
+      m_reset_pressed(false),
+      m_start_ns(0)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+    reset();
+}
+
+
+void MockSim::reset() {
+    memset(&m_state, 0, sizeof(m_state));
+    for (int i = 0; i < RF_NUM_CHANNELS; i++) {
+        m_inputs[i] = 0.5;
+    }
+    m_inputs[2] = 0.0;      // throttle closed
+
+    m_state.m_altitudeASL_MTR = GROUND_ASL_MTR;
+    m_state.m_isTouchingGround = 1.0;
+    m_state.m_batteryVoltage_VOLTS = 12.6;
+    m_state.m_batteryRemainingCapacity_MAH = BATTERY_MAH;
+    m_state.m_currentPhysicsSpeedMultiplier = 1.0;
+    m_state.m_orientationQuaternion_W = 1.0;
+    m_start_ns = monotonic_ns();
+}
+
+
+MockSim::Stats MockSim::stats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+
+RFState MockSim::state() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_state;
+}
+
+
+MockSim::Fault MockSim::next_fault() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    double total = m_config.drop_rate + m_config.error_rate + m_config.stall_rate + m_config.truncate_rate;
+    if (total <= 0.0) {
+        return FAULT_NONE;
+    }
+
+    double r = std::uniform_real_distribution<double>(0.0, 1.0)(m_rng);
+    Fault fault = FAULT_NONE;
+    if ((r -= m_config.drop_rate) < 0.0) fault = FAULT_DROP;
+    else if ((r -= m_config.error_rate) < 0.0) fault = FAULT_ERROR;
+    else if ((r -= m_config.stall_rate) < 0.0) fault = FAULT_STALL;
+    else if ((r -= m_config.truncate_rate) < 0.0) fault = FAULT_TRUNCATE;
+    if (fault != FAULT_NONE) {
+        m_stats.faults++;
+    }
+    return fault;
+}
+
+
+int64_t MockSim::next_delay_ns() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    int64_t delay_ns = (int64_t)m_config.latency_us * 1000;
+    if (m_config.jitter_us > 0) {
+        int64_t jitter_ns = (int64_t)m_config.jitter_us * 1000;
+        delay_ns += std::uniform_int_distribution<int64_t>(-jitter_ns, jitter_ns)(m_rng);
+    }
+    return delay_ns > 0 ? delay_ns : 0;
+}
+
+
+ssize_t MockSim::handle(int, const char* request, size_t len, char* reply, size_t reply_cap) {
+    Fault fault = next_fault();
+    int64_t delay_ns = next_delay_ns();
+    if (delay_ns > 0) {
+        struct timespec ts;
+        ts.tv_sec = delay_ns / 1000000000LL;
+        ts.tv_nsec = delay_ns % 1000000000LL;
+        while (clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, &ts) == EINTR) {}
+    }
+
+    switch (fault) {
+        case FAULT_DROP:
+        case FAULT_TRUNCATE:
+            return -ECONNRESET;
+        case FAULT_STALL:
+            return -ETIMEDOUT;
+        case FAULT_ERROR:
+            return error_reply(reply, reply_cap);
+        default:
+            return respond(request, len, reply, reply_cap);
+    }
+}
+
+
+ssize_t MockSim::respond(const char* request, size_t len, char* reply, size_t reply_cap) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.requests++;
+
+    const char* action;
+    size_t action_len;
+    if (!request_action(request, len, &action, &action_len)) {
+        m_stats.bad_requests++;
+        return write_fault("Missing SOAPAction", reply, reply_cap);
+    }
+
+#define IS_ACTION(name) (action_len == sizeof(name) - 1 && memcmp(action, name, action_len) == 0)
+    if (IS_ACTION("ExchangeData")) {
+        m_stats.exchanges++;
+        // Inputs are only applied while the controller is injected, but state is
+        // returned either way
+        if (m_injected) {
+            parse_inputs(request, len);
+        }
+        advance();
+        bool reset_pressed = m_reset_pressed;
+        m_reset_pressed = false;
+        return write_state(reply, reply_cap, reset_pressed);
+    }
+    if (IS_ACTION("InjectUAVControllerInterface")) {
+        m_stats.injects++;
+        m_injected = true;
+        return write_empty("InjectUAVControllerInterface", reply, reply_cap);
+    }
+    if (IS_ACTION("RestoreOriginalControllerDevice")) {
+        m_stats.restores++;
+        m_injected = false;
+        return write_empty("RestoreOriginalControllerDevice", reply, reply_cap);
+    }
+    if (IS_ACTION("ResetAircraft")) {
+        m_stats.resets++;
+        reset();
+        m_reset_pressed = true;
+        return write_empty("ResetAircraft", reply, reply_cap);
+    }
+#undef IS_ACTION
+
+    m_stats.bad_requests++;
+    return write_fault("Unknown SOAPAction", reply, reply_cap);
+}
+
+
+ssize_t MockSim::error_reply(char* reply, size_t reply_cap) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.requests++;
+    return write_fault("Injected fault", reply, reply_cap);
+}
+
+
+void MockSim::parse_inputs(const char* request, size_t len) {
+    static const char VALUES[] = "<m-channelValues-0to1>";
+    const char* end = request + len;
+    const char* p = (const char*)memmem(request, len, VALUES, sizeof(VALUES) - 1);
+    if (!p) {
+        return;
+    }
+    p += sizeof(VALUES) - 1;
+
+    for (int i = 0; i < RF_NUM_CHANNELS; i++) {
+        const char* item = (const char*)memmem(p, end - p, "<item>", 6);
+        if (!item) {
+            break;
+        }
+        m_inputs[i] = strtod(item + 6, nullptr);
+        p = item + 6;
+    }
+}
+
+
+// Catch physics time up with the wall clock, or take one fixed step
+void MockSim::advance() {
+    if (m_config.step_s > 0.0) {
+        step(m_config.step_s);
+        return;
+    }
+
+    double dt = 1.0 / m_config.physics_hz;
+    double target = (monotonic_ns() - m_start_ns) / 1e9;
+    // Long idle gaps are skipped rather than simulated step by step
+    if (target - m_state.m_currentPhysicsTime_SEC > 1.0) {
+        m_state.m_currentPhysicsTime_SEC = target - 1.0;
+    }
+    while (m_state.m_currentPhysicsTime_SEC + dt <= target) {
+        step(dt);
+    }
+}
+
+
+// A deliberately simple fixed-wing: throttle sets airspeed, elevator and aileron
+// command pitch and roll rates, bank turns the aircraft.
+void MockSim::step(double dt) {
+    RFState& s = m_state;
+    double aileron = m_inputs[0] - 0.5;
+    double elevator = m_inputs[1] - 0.5;
+    double throttle = m_inputs[2];
+    double rudder = m_inputs[3] - 0.5;
+
+    for (int i = 0; i < RF_NUM_CHANNELS; i++) {
+        s.rcin[i] = m_inputs[i];
+    }
+
+    double prev_u = s.m_velocityWorldU_MPS;
+    double prev_v = s.m_velocityWorldV_MPS;
+    double prev_w = s.m_velocityWorldW_MPS;
+
+    double target_speed = 25.0 * throttle;
+    s.m_airspeed_MPS += (target_speed - s.m_airspeed_MPS) * (1.0 - exp(-dt / 2.0));
+    bool flying = s.m_airspeed_MPS > 12.0 || s.m_altitudeAGL_MTR > 0.0;
+
+    s.m_rollRate_DEGpSEC = flying ? 240.0 * aileron - 0.5 * s.m_roll_DEG : 0.0;
+    s.m_pitchRate_DEGpSEC = flying ? 120.0 * elevator - 0.5 * s.m_inclination_DEG : 0.0;
+    s.m_roll_DEG += s.m_rollRate_DEGpSEC * dt;
+    s.m_inclination_DEG += s.m_pitchRate_DEGpSEC * dt;
+
+    double speed = s.m_airspeed_MPS > 1.0 ? s.m_airspeed_MPS : 1.0;
+    s.m_yawRate_DEGpSEC = 60.0 * rudder + (flying ? 9.81 * tan(s.m_roll_DEG * DEG) / speed / DEG : 0.0);
+    s.m_azimuth_DEG = fmod(s.m_azimuth_DEG + s.m_yawRate_DEGpSEC * dt + 360.0, 360.0);
+
+    double horizontal = s.m_airspeed_MPS * cos(s.m_inclination_DEG * DEG);
+    double climb = flying ? s.m_airspeed_MPS * sin(s.m_inclination_DEG * DEG) : 0.0;
+    s.m_velocityWorldU_MPS = horizontal * cos(s.m_azimuth_DEG * DEG);
+    s.m_velocityWorldV_MPS = horizontal * sin(s.m_azimuth_DEG * DEG);
+    s.m_velocityWorldW_MPS = -climb;
+    s.m_velocityBodyU_MPS = s.m_airspeed_MPS;
+    s.m_velocityBodyV_MPS = 0.0;
+    s.m_velocityBodyW_MPS = 0.0;
+    s.m_groundspeed_MPS = horizontal;
+
+    s.m_aircraftPositionX_MTR += s.m_velocityWorldU_MPS * dt;
+    s.m_aircraftPositionY_MTR += s.m_velocityWorldV_MPS * dt;
+    s.m_altitudeAGL_MTR += climb * dt;
+    if (s.m_altitudeAGL_MTR <= 0.0) {
+        s.m_altitudeAGL_MTR = 0.0;
+        s.m_velocityWorldW_MPS = 0.0;
+        if (s.m_inclination_DEG < 0.0) s.m_inclination_DEG = 0.0;
+        s.m_roll_DEG = 0.0;
+    }
+    s.m_altitudeASL_MTR = GROUND_ASL_MTR + s.m_altitudeAGL_MTR;
+    s.m_isTouchingGround = s.m_altitudeAGL_MTR <= 0.0 ? 1.0 : 0.0;
+
+    s.m_accelerationWorldAX_MPS2 = (s.m_velocityWorldU_MPS - prev_u) / dt;
+    s.m_accelerationWorldAY_MPS2 = (s.m_velocityWorldV_MPS - prev_v) / dt;
+    s.m_accelerationWorldAZ_MPS2 = (s.m_velocityWorldW_MPS - prev_w) / dt;
+    s.m_accelerationBodyAX_MPS2 = s.m_accelerationWorldAX_MPS2;
+    s.m_accelerationBodyAY_MPS2 = 0.0;
+    s.m_accelerationBodyAZ_MPS2 = -9.81 * cos(s.m_roll_DEG * DEG);
+
+    s.m_propRPM = throttle * 9000.0;
+    s.m_anEngineIsRunning = throttle > 0.02 ? 1.0 : 0.0;
+    s.m_batteryCurrentDraw_AMPS = 30.0 * throttle;
+    s.m_batteryRemainingCapacity_MAH -= s.m_batteryCurrentDraw_AMPS * dt / 3.6;
+    if (s.m_batteryRemainingCapacity_MAH < 0.0) s.m_batteryRemainingCapacity_MAH = 0.0;
+    s.m_batteryVoltage_VOLTS = 11.1 + 1.5 * (s.m_batteryRemainingCapacity_MAH / BATTERY_MAH)
+                               - 0.02 * s.m_batteryCurrentDraw_AMPS;
+
+    // Quaternion from roll (x), pitch (y), yaw (z)
+    double cr = cos(s.m_roll_DEG * DEG / 2), sr = sin(s.m_roll_DEG * DEG / 2);
+    double cp = cos(s.m_inclination_DEG * DEG / 2), sp = sin(s.m_inclination_DEG * DEG / 2);
+    double cy = cos(s.m_azimuth_DEG * DEG / 2), sy = sin(s.m_azimuth_DEG * DEG / 2);
+    s.m_orientationQuaternion_W = cr * cp * cy + sr * sp * sy;
+    s.m_orientationQuaternion_X = sr * cp * cy - cr * sp * sy;
+    s.m_orientationQuaternion_Y = cr * sp * cy + sr * cp * sy;
+    s.m_orientationQuaternion_Z = cr * cp * sy - sr * sp * cy;
+
+    s.m_currentPhysicsTime_SEC += dt;
+}
+
+
+ssize_t MockSim::write_state(char* reply, size_t reply_cap, bool reset_pressed) {
+    if (reply_cap <= HEADER_ROOM) {
+        return -EMSGSIZE;
+    }
+    const RFState& s = m_state;
+    Writer w(reply + HEADER_ROOM, reply_cap - HEADER_ROOM);
+
+    w.add("%s<ReturnData><m-previousInputsState><m-selectedChannels>-1</m-selectedChannels>"
+          "<m-channelValues-0to1 xsi:type=\"SOAP-ENC:Array\" SOAP-ENC:arrayType=\"xsd:double[%d]\">",
+          ENVELOPE_OPEN, RF_NUM_CHANNELS);
+    for (int i = 0; i < RF_NUM_CHANNELS; i++) {
+        w.add("<item>%.6f</item>", s.rcin[i]);
+    }
+    w.add("</m-channelValues-0to1></m-previousInputsState><m-aircraftState>");
+    w.number("m-currentPhysicsTime-SEC", s.m_currentPhysicsTime_SEC);
+    w.number("m-currentPhysicsSpeedMultiplier", s.m_currentPhysicsSpeedMultiplier);
+    w.number("m-airspeed-MPS", s.m_airspeed_MPS);
+    w.number("m-altitudeASL-MTR", s.m_altitudeASL_MTR);
+    w.number("m-altitudeAGL-MTR", s.m_altitudeAGL_MTR);
+    w.number("m-groundspeed-MPS", s.m_groundspeed_MPS);
+    w.number("m-pitchRate-DEGpSEC", s.m_pitchRate_DEGpSEC);
+    w.number("m-rollRate-DEGpSEC", s.m_rollRate_DEGpSEC);
+    w.number("m-yawRate-DEGpSEC", s.m_yawRate_DEGpSEC);
+    w.number("m-azimuth-DEG", s.m_azimuth_DEG);
+    w.number("m-inclination-DEG", s.m_inclination_DEG);
+    w.number("m-roll-DEG", s.m_roll_DEG);
+    w.number("m-orientationQuaternion-X", s.m_orientationQuaternion_X);
+    w.number("m-orientationQuaternion-Y", s.m_orientationQuaternion_Y);
+    w.number("m-orientationQuaternion-Z", s.m_orientationQuaternion_Z);
+    w.number("m-orientationQuaternion-W", s.m_orientationQuaternion_W);
+    w.number("m-aircraftPositionX-MTR", s.m_aircraftPositionX_MTR);
+    w.number("m-aircraftPositionY-MTR", s.m_aircraftPositionY_MTR);
+    w.number("m-velocityWorldU-MPS", s.m_velocityWorldU_MPS);
+    w.number("m-velocityWorldV-MPS", s.m_velocityWorldV_MPS);
+    w.number("m-velocityWorldW-MPS", s.m_velocityWorldW_MPS);
+    w.number("m-velocityBodyU-MPS", s.m_velocityBodyU_MPS);
+    w.number("m-velocityBodyV-MPS", s.m_velocityBodyV_MPS);
+    w.number("m-velocityBodyW-MPS", s.m_velocityBodyW_MPS);
+    w.number("m-accelerationWorldAX-MPS2", s.m_accelerationWorldAX_MPS2);
+    w.number("m-accelerationWorldAY-MPS2", s.m_accelerationWorldAY_MPS2);
+    w.number("m-accelerationWorldAZ-MPS2", s.m_accelerationWorldAZ_MPS2);
+    w.number("m-accelerationBodyAX-MPS2", s.m_accelerationBodyAX_MPS2);
+    w.number("m-accelerationBodyAY-MPS2", s.m_accelerationBodyAY_MPS2);
+    w.number("m-accelerationBodyAZ-MPS2", s.m_accelerationBodyAZ_MPS2);
+    w.number("m-windX-MPS", s.m_windX_MPS);
+    w.number("m-windY-MPS", s.m_windY_MPS);
+    w.number("m-windZ-MPS", s.m_windZ_MPS);
+    w.number("m-propRPM", s.m_propRPM);
+    w.number("m-heliMainRotorRPM", s.m_heliMainRotorRPM);
+    w.number("m-batteryVoltage-VOLTS", s.m_batteryVoltage_VOLTS);
+    w.number("m-batteryCurrentDraw-AMPS", s.m_batteryCurrentDraw_AMPS);
+    w.number("m-batteryRemainingCapacity-MAH", s.m_batteryRemainingCapacity_MAH);
+    w.number("m-fuelRemaining-OZ", s.m_fuelRemaining_OZ);
+    w.flag("m-isLocked", s.m_isLocked != 0.0);
+    w.flag("m-hasLostComponents", s.m_hasLostComponents != 0.0);
+    w.flag("m-anEngineIsRunning", s.m_anEngineIsRunning != 0.0);
+    w.flag("m-isTouchingGround", s.m_isTouchingGround != 0.0);
+    w.add("<m-currentAircraftStatus>%s</m-currentAircraftStatus>",
+          s.m_isTouchingGround != 0.0 && s.m_airspeed_MPS < 1.0 ? "CAS-WAITINGTOLAUNCH" : "CAS-FLYING");
+    w.add("</m-aircraftState><m-notifications>");
+    w.flag("m-resetButtonHasBeenPressed", reset_pressed);
+    w.add("</m-notifications>");
+    w.flag("m-flightAxisControllerIsActive", m_injected);
+    w.add("</ReturnData>%s", ENVELOPE_CLOSE);
+
+    if (w.overflow) {
+        return -EMSGSIZE;
+    }
+    return finish_http("200 OK", reply, reply_cap, HEADER_ROOM, w.len);
+}
+
+
+ssize_t MockSim::write_empty(const char* action, char* reply, size_t reply_cap) {
+    if (reply_cap <= HEADER_ROOM) {
+        return -EMSGSIZE;
+    }
+    Writer w(reply + HEADER_ROOM, reply_cap - HEADER_ROOM);
+    w.add("%s<%sResponse/>%s", ENVELOPE_OPEN, action, ENVELOPE_CLOSE);
+    if (w.overflow) {
+        return -EMSGSIZE;
+    }
+    return finish_http("200 OK", reply, reply_cap, HEADER_ROOM, w.len);
+}
+
+
+ssize_t MockSim::write_fault(const char* message, char* reply, size_t reply_cap) {
+    if (reply_cap <= HEADER_ROOM) {
+        return -EMSGSIZE;
+    }
+    Writer w(reply + HEADER_ROOM, reply_cap - HEADER_ROOM);
+    w.add("%s<SOAP-ENV:Fault><faultcode>SOAP-ENV:Server</faultcode><faultstring>%s</faultstring>"
+          "</SOAP-ENV:Fault>%s", ENVELOPE_OPEN, message, ENVELOPE_CLOSE);
+    if (w.overflow) {
+        return -EMSGSIZE;
+    }
+    return finish_http("500 Internal Server Error", reply, reply_cap, HEADER_ROOM, w.len);
+}
+
+} // namespace RF
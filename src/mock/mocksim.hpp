@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <random>
+#include <sys/types.h>
+
+#include "src/rfstate.hpp"
+#include "src/rfcmd.hpp"
+
+namespace RF {
+
+// Behaviour of the mock simulator. Defaults are a well-behaved RealFlight on a LAN.
+struct MockConfig {
+    // Reply delay: latency_us plus a uniform +-jitter_us
+    uint32_t latency_us;
+    uint32_t jitter_us;
+
+    // Fault injection, each a probability per request (0..1):
+    double drop_rate;       // close the connection without replying
+    double error_rate;      // reply 500 with a SOAP fault
+    double stall_rate;      // never reply (client has to time out)
+    double truncate_rate;   // send half the reply, then close
+
+    // Physics time. With step_s > 0 every ExchangeData advances it by exactly step_s
+    // (deterministic, for benchmarks). Otherwise it follows the wall clock at
+    // physics_hz, like RealFlight, so polling faster than that repeats frames.
+    double step_s;
+    double physics_hz;
+
+    uint32_t seed;
+
+    MockConfig()
+        : latency_us(0),
+          jitter_us(0),
+          drop_rate(0.0),
+          error_rate(0.0),
+          stall_rate(0.0),
+          truncate_rate(0.0),
+          step_s(0.0),
+          physics_hz(400.0),
+          seed(1)
+    {}
+};
+
+// The RealFlight side of the protocol without any I/O: parses a SOAP request, runs a
+// small flight model and writes the reply. Handles InjectUAVControllerInterface,
+// ExchangeData, ResetAircraft and RestoreOriginalControllerDevice.
+//
+// handle() matches the LoopbackTransport Handler interface, so the same simulator
+// can sit behind MockServer (TCP) or be called in-process. Thread safe.
+class MockSim {
+public:
+    enum Fault { FAULT_NONE, FAULT_DROP, FAULT_ERROR, FAULT_STALL, FAULT_TRUNCATE };
+
+    struct Stats {
+        uint64_t requests;
+        uint64_t exchanges;
+        uint64_t injects;
+        uint64_t restores;
+        uint64_t resets;
+        uint64_t bad_requests;
+        uint64_t faults;
+    };
+
+    explicit MockSim(const MockConfig& config = MockConfig());
+
+    // Reply to one complete request; returns the reply length, or a negative errno if
+    // it doesn't fit (reply is always NUL terminated)
+    ssize_t respond(const char* request, size_t len, char* reply, size_t reply_cap);
+
+    // 500 reply for an injected FAULT_ERROR
+    ssize_t error_reply(char* reply, size_t reply_cap);
+
+    // Fault to inject for the next request, drawn from the configured rates
+    Fault next_fault();
+
+    // Reply delay for the next request, in ns
+    int64_t next_delay_ns();
+
+    // LoopbackTransport handler: delay, faults and reply in one call. Drops, stalls
+    // and truncations fail the exchange.
+    ssize_t handle(int endpoint, const char* request, size_t len, char* reply, size_t reply_cap);
+
+    const MockConfig& config() const { return m_config; }
+    Stats stats();
+    RFState state();
+
+private:
+    ssize_t write_state(char* reply, size_t reply_cap, bool reset_pressed);
+    ssize_t write_empty(const char* action, char* reply, size_t reply_cap);
+    ssize_t write_fault(const char* message, char* reply, size_t reply_cap);
+    void parse_inputs(const char* request, size_t len);
+    void advance();
+    void step(double dt);
+    void reset();
+
+    MockConfig m_config;
+    std::mutex m_mutex;
+    std::mt19937 m_rng;
+
+    RFState m_state;
+    double m_inputs[RF_NUM_CHANNELS];
+    bool m_injected;
+    bool m_reset_pressed;
+    int64_t m_start_ns;     // wall clock at physics time 0
+    Stats m_stats;
+};
+
+} // namespace RF
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+
+#include "latencyhistogram.hpp"
+#include "transport.hpp"
+
+namespace RF {
+
+// Where the time of one ExchangeData goes
+enum ExchangePhase {
+    PHASE_BUILD,        // command taken -> request bytes ready
+    PHASE_CONNECT,      // transport start -> connection usable (0 on a pre-opened one)
+    PHASE_SEND,         // connection usable -> request written
+    PHASE_WAIT,         // request written -> first reply bytes (simulator + network)
+    PHASE_RECEIVE,      // first reply bytes -> complete reply
+    PHASE_EXCHANGE,     // transport start -> complete reply, for every backend
+    PHASE_PARSE,        // complete reply -> state parsed
+    PHASE_PUBLISH,      // seqlock, subscriber rings, shm, wake-ups
+    PHASE_TOTAL,        // command taken -> frame published
+    NUM_PHASES
+};
+
+inline const char* phase_name(int phase) {
+    static const char* const names[NUM_PHASES] = {
+        "build", "connect", "send", "wait", "receive", "exchange", "parse", "publish", "total"
+    };
+    return (phase >= 0 && phase < NUM_PHASES) ? names[phase] : "?";
+}
+
+// One LatencyHistogram per phase, written by the update thread only. Backends that
+// can't see connect / send / first byte (io_uring, loopback) leave those phases
+// empty; PHASE_EXCHANGE always has the network part.
+class PhaseStats {
+public:
+    // A successful exchange: taken before the request was built, t from the
+    // transport, parsed when the frame was stamped, published once readers had it
+    void record(int64_t taken, const ExchangeTimes& t, int64_t parsed, int64_t published) {
+        m_hist[PHASE_BUILD].record(t.start - taken);
+        if (t.connected) {
+            m_hist[PHASE_CONNECT].record(t.connected - t.start);
+            if (t.sent) {
+                m_hist[PHASE_SEND].record(t.sent - t.connected);
+                if (t.first_byte) {
+                    m_hist[PHASE_WAIT].record(t.first_byte - t.sent);
+                    m_hist[PHASE_RECEIVE].record(t.done - t.first_byte);
+                }
+            }
+        }
+        m_hist[PHASE_EXCHANGE].record(t.done - t.start);
+        m_hist[PHASE_PARSE].record(parsed - t.done);
+        m_hist[PHASE_PUBLISH].record(published - parsed);
+        m_hist[PHASE_TOTAL].record(published - taken);
+    }
+
+    const LatencyHistogram& histogram(int phase) const { return m_hist[phase]; }
+
+    void snapshot(LatencyHistogram::Snapshot* out) const {
+        for (int i = 0; i < NUM_PHASES; i++) {
+            m_hist[i].snapshot(out[i]);
+        }
+    }
+
+    // {"build":{"n":..,"mean_us":..,"p50_us":..,"p99_us":..,"p999_us":..,"max_us":..},...}
+    static void print_json(std::ostream& os, const LatencyHistogram::Snapshot* snaps) {
+        os << "{";
+        for (int i = 0; i < NUM_PHASES; i++) {
+            print_entry(os, i ? "," : "", phase_name(i), snaps[i]);
+        }
+        os << "}";
+    }
+
+    // "name":{"n":..,...} preceded by sep
+    static void print_entry(std::ostream& os, const char* sep, const char* name, const LatencyHistogram::Snapshot& s) {
+        char buf[192];
+        snprintf(buf, sizeof(buf),
+                 "%s\"%s\":{\"n\":%llu,\"mean_us\":%.3f,\"p50_us\":%.3f,\"p99_us\":%.3f,"
+                 "\"p999_us\":%.3f,\"max_us\":%.3f}",
+                 sep, name, (unsigned long long)s.count, s.mean_ns() / 1000.0,
+                 s.percentile(50) / 1000.0, s.percentile(99) / 1000.0,
+                 s.percentile(99.9) / 1000.0, s.max_ns / 1000.0);
+        os << buf;
+    }
+
+private:
+    LatencyHistogram m_hist[NUM_PHASES];
+};
+
+} // namespace RF
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <atomic>
+#include <ostream>
+
+namespace RF {
+
+// What a reply's m-currentPhysicsTime-SEC says about the frame
+enum FrameKind {
+    FRAME_NEW,          // the simulator stepped once since the last reply (or first reply)
+    FRAME_GAP,          // it stepped more than once: the steps in between were never seen
+    FRAME_DUPLICATE,    // it hadn't stepped: same state as the last reply
+    FRAME_RESTART,      // physics time went backwards (new flight, simulator restarted)
+};
+
+// Accounting of successive physics timestamps against the exchanges that carried
+// them: whether raising the exchange rate still gets new frames, or only repeats.
+// Written by the update thread only; stats() can be called from any thread (the
+// counters are individually, not jointly, consistent).
+//
+// The simulator's step is taken to be the smallest advance seen, so if every
+// exchange is slower than the simulator for a whole run the step is overestimated
+// and gaps undercounted.
+class PhysicsClock {
+public:
+    struct Stats {
+        uint64_t frames;            // replies seen
+        uint64_t duplicates;
+        uint64_t gaps;              // frames after missed steps
+        uint64_t missed_steps;      // steps never seen, in total
+        uint64_t restarts;
+        double step_s;              // estimated simulator step, 0 until time advances
+        double physics_s;           // physics time advanced over the frames
+        double wall_s;              // first to last frame
+
+        double exchange_hz() const { return wall_s > 0.0 ? (frames - 1) / wall_s : 0.0; }
+        double new_frame_hz() const { return wall_s > 0.0 ? (frames - 1 - duplicates) / wall_s : 0.0; }
+        double sim_step_hz() const { return wall_s > 0.0 && step_s > 0.0 ? physics_s / step_s / wall_s : 0.0; }
+    };
+
+    PhysicsClock()
+        : m_frames(0), m_duplicates(0), m_gaps(0), m_missed_steps(0), m_restarts(0),
+          m_step_s(0.0), m_physics_s(0.0), m_first_ns(0), m_last_ns(0), m_last_time(0.0)
+    {}
+
+    // A reply with physics time physics_s parsed at now_ns
+    FrameKind observe(double physics_s, int64_t now_ns) {
+        uint64_t frames = m_frames.load(std::memory_order_relaxed);
+        double last = m_last_time;
+        m_last_time = physics_s;
+        m_last_ns.store(now_ns, std::memory_order_relaxed);
+        m_frames.store(frames + 1, std::memory_order_release);
+
+        if (frames == 0) {
+            m_first_ns.store(now_ns, std::memory_order_relaxed);
+            return FRAME_NEW;
+        }
+
+        double delta = physics_s - last;
+        if (delta == 0.0) {
+            bump(m_duplicates);
+            return FRAME_DUPLICATE;
+        }
+        if (delta < 0.0) {
+            bump(m_restarts);
+            return FRAME_RESTART;
+        }
+
+        m_physics_s.store(m_physics_s.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+
+        // Printed times carry rounding noise: only a clearly smaller advance is a new step
+        double step = m_step_s.load(std::memory_order_relaxed);
+        if (step == 0.0 || delta < step * 0.75) {
+            m_step_s.store(delta, std::memory_order_relaxed);
+            return FRAME_NEW;
+        }
+
+        uint64_t steps = (uint64_t)llround(delta / step);
+        if (steps <= 1) {
+            return FRAME_NEW;
+        }
+        bump(m_gaps);
+        m_missed_steps.store(m_missed_steps.load(std::memory_order_relaxed) + steps - 1, std::memory_order_relaxed);
+        return FRAME_GAP;
+    }
+
+    Stats stats() const {
+        Stats s;
+        s.frames = m_frames.load(std::memory_order_acquire);
+        s.duplicates = m_duplicates.load(std::memory_order_relaxed);
+        s.gaps = m_gaps.load(std::memory_order_relaxed);
+        s.missed_steps = m_missed_steps.load(std::memory_order_relaxed);
+        s.restarts = m_restarts.load(std::memory_order_relaxed);
+        s.step_s = m_step_s.load(std::memory_order_relaxed);
+        s.physics_s = m_physics_s.load(std::memory_order_relaxed);
+        s.wall_s = s.frames > 1 ?
+            (m_last_ns.load(std::memory_order_relaxed) - m_first_ns.load(std::memory_order_relaxed)) / 1e9 : 0.0;
+        return s;
+    }
+
+    // {"frames":N,...,"exchange_hz":X,"new_frame_hz":X,"sim_step_hz":X}
+    static void print_json(std::ostream& os, const Stats& s) {
+        os << "{\"frames\":" << s.frames
+           << ",\"duplicates\":" << s.duplicates
+           << ",\"gaps\":" << s.gaps
+           << ",\"missed_steps\":" << s.missed_steps
+           << ",\"restarts\":" << s.restarts
+           << ",\"step_s\":" << s.step_s
+           << ",\"exchange_hz\":" << s.exchange_hz()
+           << ",\"new_frame_hz\":" << s.new_frame_hz()
+           << ",\"sim_step_hz\":" << s.sim_step_hz() << "}";
+    }
+
+private:
+    static void bump(std::atomic<uint64_t>& counter) {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> m_frames;
+    std::atomic<uint64_t> m_duplicates;
+    std::atomic<uint64_t> m_gaps;
+    std::atomic<uint64_t> m_missed_steps;
+    std::atomic<uint64_t> m_restarts;
+    std::atomic<double> m_step_s;
+    std::atomic<double> m_physics_s;
+    std::atomic<int64_t> m_first_ns;
+    std::atomic<int64_t> m_last_ns;
+    double m_last_time;             // update thread only
+};
+
+} // namespace RF
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <time.h>
+#include <errno.h>
+#include <cstdint>
+#include <atomic>
+
+#include "rfcmd.hpp"
+
+namespace RF {
+
+// Paces a loop at a fixed rate on an absolute time grid: slot k starts at
+// start + k * period, so lateness in one iteration never shifts the ones after it.
+// Sleeps with clock_nanosleep(TIMER_ABSTIME) until shortly before the slot and spins
+// the rest of the way, which is far more precise than sleeping all the way without
+// burning a core.
+//
+// When an iteration overruns its slot the next one starts immediately and any slots
+// that passed completely are skipped rather than run back to back to catch up.
+class RateScheduler {
+public:
+    // rate_hz <= 0 disables pacing: wait() returns immediately
+    explicit RateScheduler(double rate_hz = 0.0, int64_t spin_ns = 50000)
+        : m_period_ns(rate_hz > 0.0 ? (int64_t)(1e9 / rate_hz) : 0),
+          m_spin_ns(spin_ns),
+          m_next_ns(0),
+          m_overruns(0),
+          m_skipped(0)
+    {}
+
+    bool enabled() const { return m_period_ns > 0; }
+    int64_t period_ns() const { return m_period_ns; }
+
+    // Anchor the grid: the first wait() returns one period from now
+    void start() {
+        m_next_ns = monotonic_ns() + m_period_ns;
+    }
+
+    // Block until the next slot. Returns the number of whole slots skipped.
+    uint64_t wait() {
+        if (!enabled()) {
+            return 0;
+        }
+        if (m_next_ns == 0) {
+            start();
+        }
+
+        int64_t now = monotonic_ns();
+        uint64_t skipped = 0;
+
+        if (now >= m_next_ns) {
+            // Overran this slot: run now and realign to the grid
+            m_overruns.fetch_add(1, std::memory_order_relaxed);
+            skipped = (now - m_next_ns) / m_period_ns;
+            m_skipped.fetch_add(skipped, std::memory_order_relaxed);
+            m_next_ns += (skipped + 1) * m_period_ns;
+            return skipped;
+        }
+
+        int64_t wake_ns = m_next_ns - m_spin_ns;
+        if (wake_ns > now) {
+            struct timespec ts;
+            ts.tv_sec = wake_ns / 1000000000LL;
+            ts.tv_nsec = wake_ns % 1000000000LL;
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+            }
+        }
+        while (monotonic_ns() < m_next_ns) {
+            // Spin the last few microseconds
+        }
+
+        m_next_ns += m_period_ns;
+        return 0;
+    }
+
+    // Iterations that started after their slot, and slots skipped entirely
+    uint64_t overruns() const { return m_overruns.load(std::memory_order_relaxed); }
+    uint64_t skipped() const { return m_skipped.load(std::memory_order_relaxed); }
+
+private:
+    int64_t m_period_ns;
+    int64_t m_spin_ns;
+    int64_t m_next_ns;
+
+    std::atomic<uint64_t> m_overruns;
+    std::atomic<uint64_t> m_skipped;
+};
+
+} // namespace RF
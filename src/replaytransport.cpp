@@ -0,0 +1,202 @@
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <strings.h>
+
+#include <iostream>
+
+#include "replaytransport.hpp"
+#include "rfcmd.hpp"
+
+namespace RF {
+
+static const char REPLAY_MAGIC[] = "RFREPLAY 1\n";
+static const char EMPTY_OK_REPLY[] = "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n";
+
+
+bool request_action(const char* data, size_t len, const char** action, size_t* action_len) {
+    static const char HEADER[] = "Soapaction: '";
+    const size_t header_len = sizeof(HEADER) - 1;
+
+    const char* end = data + len;
+    for (const char* p = data; p + header_len <= end; ) {
+        if (strncasecmp(p, HEADER, header_len) == 0) {
+            const char* start = p + header_len;
+            const char* quote = (const char*)memchr(start, '\'', end - start);
+            if (!quote) {
+                return false;
+            }
+            *action = start;
+            *action_len = quote - start;
+            return true;
+        }
+        // Headers only: stop at the blank line
+        const char* eol = (const char*)memchr(p, '\n', end - p);
+        if (!eol || eol + 1 >= end || eol[1] == '\r' || eol[1] == '\n') {
+            return false;
+        }
+        p = eol + 1;
+    }
+    return false;
+}
+
+
+bool ReplayRecorder::open(const char* path) {
+    close();
+    m_file = fopen(path, "wb");
+    if (!m_file) {
+        std::cerr << "[ERROR] ReplayRecorder: can't create " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    fputs(REPLAY_MAGIC, m_file);
+    return true;
+}
+
+
+void ReplayRecorder::close() {
+    if (m_file) {
+        fclose(m_file);
+        m_file = nullptr;
+    }
+}
+
+
+void ReplayRecorder::record(const char* request, size_t request_len, const char* reply, size_t reply_len) {
+    const char* action;
+    size_t action_len;
+    if (!m_file || !request_action(request, request_len, &action, &action_len)) {
+        return;
+    }
+    fprintf(m_file, "%.*s %zu\n", (int)action_len, action, reply_len);
+    fwrite(reply, 1, reply_len, m_file);
+    fputc('\n', m_file);
+    m_records++;
+}
+
+
+ReplayTransport::ReplayTransport() : m_num_endpoints(0) {}
+
+
+bool ReplayTransport::load(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        std::cerr << "[ERROR] ReplayTransport: can't open " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    char line[256];
+    if (!fgets(line, sizeof(line), f) || strcmp(line, REPLAY_MAGIC) != 0) {
+        std::cerr << "[ERROR] ReplayTransport: " << path << " is not a recording" << std::endl;
+        fclose(f);
+        return false;
+    }
+
+    const char* error = nullptr;
+    size_t loaded = 0;
+    char action[128];
+    size_t reply_len;
+    while (fgets(line, sizeof(line), f)) {
+        if (!strchr(line, '\n') || sscanf(line, "%127s %zu", action, &reply_len) != 2) {
+            error = "has a bad record header";
+            break;
+        }
+        // Anything longer could never be replayed, and a corrupt length must not
+        // turn into a huge allocation
+        if (reply_len >= MAX_REPLY_BYTES) {
+            error = "has a reply longer than the reply buffer";
+            break;
+        }
+        std::string reply(reply_len, '\0');
+        if (fread(&reply[0], 1, reply_len, f) != reply_len || fgetc(f) != '\n') {
+            error = "is truncated";
+            break;
+        }
+        add_reply(action, reply);
+        loaded++;
+    }
+    fclose(f);
+
+    if (error) {
+        std::cerr << "[WARN] ReplayTransport: " << path << " " << error << ", loaded " << loaded << " replies" << std::endl;
+    }
+    return loaded > 0;
+}
+
+
+void ReplayTransport::add_reply(const std::string& action, const std::string& reply) {
+    Track* track = find(action.c_str(), action.length());
+    if (!track) {
+        m_tracks.push_back(Track());
+        track = &m_tracks.back();
+        track->action = action;
+        track->next = 0;
+    }
+    track->replies.push_back(reply);
+}
+
+
+size_t ReplayTransport::replies(const char* action) const {
+    for (size_t i = 0; i < m_tracks.size(); i++) {
+        if (m_tracks[i].action == action) {
+            return m_tracks[i].replies.size();
+        }
+    }
+    return 0;
+}
+
+
+ReplayTransport::Track* ReplayTransport::find(const char* action, size_t action_len) {
+    for (size_t i = 0; i < m_tracks.size(); i++) {
+        const std::string& name = m_tracks[i].action;
+        if (name.length() == action_len && memcmp(name.data(), action, action_len) == 0) {
+            return &m_tracks[i];
+        }
+    }
+    return nullptr;
+}
+
+
+int ReplayTransport::add_endpoint(const char*, uint16_t, size_t) {
+    return m_num_endpoints++;
+}
+
+
+ssize_t ReplayTransport::exchange(int endpoint, const char* data, size_t len,
+                                  char* reply, size_t reply_cap, const Deadline& deadline) {
+    m_exchanges++;
+    m_times.start = monotonic_ns();
+    m_times.connected = m_times.sent = m_times.first_byte = 0;
+    m_times.done = m_times.start;
+    if (endpoint < 0 || endpoint >= m_num_endpoints || reply_cap == 0) {
+        return -EINVAL;
+    }
+    if (deadline.at_ns <= m_times.start) {
+        return -ETIMEDOUT;
+    }
+
+    const char* action;
+    size_t action_len;
+    if (!request_action(data, len, &action, &action_len)) {
+        return -EPROTO;
+    }
+
+    const char* out = EMPTY_OK_REPLY;
+    size_t out_len = sizeof(EMPTY_OK_REPLY) - 1;
+    Track* track = find(action, action_len);
+    if (track && !track->replies.empty()) {
+        const std::string& recorded = track->replies[track->next];
+        track->next = (track->next + 1) % track->replies.size();
+        out = recorded.data();
+        out_len = recorded.length();
+    }
+
+    if (out_len >= reply_cap) {
+        return -EMSGSIZE;
+    }
+    memcpy(reply, out, out_len);
+    reply[out_len] = '\0';
+    m_times.done = monotonic_ns();
+    return out_len;
+}
+
+} // namespace RF
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <sys/types.h>
+
+#include "transport.hpp"
+#include "deadline.hpp"
+
+namespace RF {
+
+// SOAPAction of an HTTP request ("ExchangeData", ...). Points into data; false if the
+// header is missing.
+bool request_action(const char* data, size_t len, const char** action, size_t* action_len);
+
+// Writes exchanges to a recording that ReplayTransport can load. Format, repeated:
+//   <action> <reply length>\n<reply bytes>\n
+// after a "RFREPLAY 1\n" line.
+class ReplayRecorder {
+public:
+    ReplayRecorder() : m_file(nullptr), m_records(0) {}
+    ~ReplayRecorder() { close(); }
+
+    bool open(const char* path);
+    void close();
+    bool is_open() const { return m_file != nullptr; }
+
+    void record(const char* request, size_t request_len, const char* reply, size_t reply_len);
+
+    uint64_t records() const { return m_records; }
+
+private:
+    FILE* m_file;
+    uint64_t m_records;
+};
+
+
+// Answers every exchange from recorded replies, without a simulator or sockets. The
+// replies for each action are played in order and then from the start again. Actions
+// with nothing recorded get an empty "200 OK", so connect() and disconnect() succeed.
+class ReplayTransport final : public Transport {
+public:
+    ReplayTransport();
+
+    // Load a file written by ReplayRecorder / RecordingTransport, adding to any
+    // replies already loaded
+    bool load(const char* path);
+
+    void add_reply(const std::string& action, const std::string& reply);
+
+    const char* name() const override { return "replay"; }
+
+    int add_endpoint(const char* ip, uint16_t port, size_t prewarm) override;
+
+    ssize_t exchange(int endpoint, const char* data, size_t len,
+                     char* reply, size_t reply_cap, const Deadline& deadline) override;
+
+    // Replies available for action
+    size_t replies(const char* action) const;
+
+private:
+    struct Track {
+        std::string action;
+        std::vector<std::string> replies;
+        size_t next;
+    };
+
+    Track* find(const char* action, size_t action_len);
+
+    std::vector<Track> m_tracks;
+    int m_num_endpoints;
+};
+
+
+// Policy that passes exchanges through to Inner and records every reply, e.g.
+// RecordingTransport<EpollTransport> against a real simulator to make a recording for
+// ReplayTransport.
+template <class Inner>
+class RecordingTransport {
+public:
+    template <class... InnerArgs>
+    explicit RecordingTransport(const char* path, InnerArgs&&... inner_args)
+        : m_inner(std::forward<InnerArgs>(inner_args)...)
+    {
+        m_recorder.open(path);
+    }
+
+    const char* name() const { return m_inner.name(); }
+
+    int add_endpoint(const char* ip, uint16_t port, size_t prewarm) {
+        return m_inner.add_endpoint(ip, port, prewarm);
+    }
+
+    ssize_t exchange(int endpoint, const char* data, size_t len,
+                     char* reply, size_t reply_cap, const Deadline& deadline) {
+        ssize_t n = m_inner.exchange(endpoint, data, len, reply, reply_cap, deadline);
+        if (n > 0) {
+            m_recorder.record(data, len, reply, n);
+        }
+        return n;
+    }
+
+    uint64_t syscalls() const { return m_inner.syscalls(); }
+    uint64_t exchanges() const { return m_inner.exchanges(); }
+    const ExchangeTimes& last_times() const { return m_inner.last_times(); }
+
+    Inner& inner() { return m_inner; }
+    const ReplayRecorder& recorder() const { return m_recorder; }
+
+private:
+    Inner m_inner;
+    ReplayRecorder m_recorder;
+};
+
+} // namespace RF
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <chrono>
+
+namespace RF {
+
+// Control command sent to RealFlight on every exchange. Values are in [0, 1].
+struct RFCmd {
+    double throttle;
+    double aileron;
+    double elevator; 
+    double rudder;
+    double flaps;
+    double gear;
+
+    // Raw values for sources that drive all 12 RealFlight channels: where bit i of
+    // channel_mask is set, channels[i] is sent instead of the mapping above
+    uint32_t channel_mask;
+    double channels[12];
+
+    // CLOCK_MONOTONIC time (as monotonic_ns()) of the input event this command came
+    // from, e.g. the joystick's kernel timestamp; 0 if unknown. Feeds the
+    // input_to_sent / input_to_parsed latency histograms.
+    int64_t input_ns;
+};
+
+static const int RF_NUM_CHANNELS = 12;
+
+// Sticks centred, throttle closed. Sent until a producer publishes something.
+inline RFCmd neutral_cmd() {
+    RFCmd cmd;
+    cmd.throttle = 0.0;
+    cmd.aileron = 0.5;
+    cmd.elevator = 0.5;
+    cmd.rudder = 0.5;
+    cmd.flaps = 0.5;
+    cmd.gear = 0.5;
+    cmd.channel_mask = 0;
+    for (int i = 0; i < RF_NUM_CHANNELS; i++) {
+        cmd.channels[i] = 0.0;
+    }
+    cmd.input_ns = 0;
+    return cmd;
+}
+
+// Monotonic timestamp in nanoseconds, used to stamp commands and frames
+inline int64_t monotonic_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace RF
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "transport.hpp"
+#include "rtthread.hpp"
+
+namespace RF {
+
+// Budget for a whole request (connect + send + receive) per SOAP action
+struct ActionTimeouts {
+    uint32_t exchange_data_ms;      // ExchangeData, every frame: keep it tight
+    uint32_t controller_ms;         // InjectUAVControllerInterface / RestoreOriginalControllerDevice
+    uint32_t reset_aircraft_ms;     // ResetAircraft, RealFlight can take a while
+
+    ActionTimeouts()
+        : exchange_data_ms(100),
+          controller_ms(1000),
+          reset_aircraft_ms(2000)
+    {}
+};
+
+// Construction-time settings for RFInterface. Defaults match the original behaviour,
+// except the timeouts: every action used to get 1 s, ExchangeData now gets 100 ms
+// and ResetAircraft 2 s.
+struct RFConfig {
+    TransportKind transport;        // picked at runtime by kernel support by default
+    size_t prewarm_connections;     // pre-opened connections (epoll backend)
+    ActionTimeouts timeouts;
+
+    ThreadConfig update_thread;     // the exchange loop
+    ThreadConfig input_thread;      // joystick polling
+    bool lock_memory;               // mlockall, which also faults in the hot buffers
+
+    // Print exchange interval jitter every this many exchanges (0: never). The first
+    // window runs before the realtime settings above are applied so the two can be
+    // compared.
+    uint32_t jitter_window;
+
+    // Exchange rate. 0 runs exchanges back to back as fast as the network allows.
+    double update_rate_hz;
+    uint32_t spin_us;               // spin this long before each slot instead of sleeping
+
+    // Also publish every frame into this POSIX shared-memory segment (e.g.
+    // "/rf_telemetry") for other processes, keeping the last shm_history frames.
+    // nullptr disables it.
+    const char* shm_name;
+    uint32_t shm_history;
+
+    // Time every exchange phase into phase_histogram() (a handful of clock reads per
+    // frame), and print a JSON line of the last interval's phases every
+    // phase_dump_s seconds from a thread of its own (0: never)
+    bool phase_timing;
+    double phase_dump_s;
+
+    // Publish replies whose physics time hasn't moved since the last one (the
+    // simulator hadn't stepped). They're counted in frame_stats() either way. Keep
+    // this on for simulators that don't report physics time.
+    bool publish_duplicates;
+
+    // Record every exchange (parsed frame, command sent, phase timestamps) into
+    // memory-mapped files "<record_path>.0000.rfrec", ... of record_file_mb each (see
+    // flightrecorder.hpp), keeping the last record_keep_files of them (0: all) and
+    // msyncing every record_sync_s. nullptr disables it.
+    const char* record_path;
+    uint32_t record_file_mb;
+    uint32_t record_keep_files;
+    double record_sync_s;
+
+    // Also write every published frame to this compressed columnar log (see
+    // columnlog.hpp), column_log_block_frames frames to a block, from a thread of
+    // its own. nullptr disables it.
+    const char* column_log_path;
+    uint32_t column_log_block_frames;
+
+    RFConfig()
+        : transport(TRANSPORT_AUTO),
+          prewarm_connections(3),
+          lock_memory(false),
+          jitter_window(0),
+          update_rate_hz(0.0),
+          spin_us(50),
+          shm_name(nullptr),
+          shm_history(256),
+          phase_timing(true),
+          phase_dump_s(0.0),
+          publish_duplicates(true),
+          record_path(nullptr),
+          record_file_mb(64),
+          record_keep_files(0),
+          record_sync_s(1.0),
+          column_log_path(nullptr),
+          column_log_block_frames(1024)
+    {}
+};
+
+} // namespace RF
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+
+namespace RF {
+
+// Aircraft state as returned by ExchangeData, one double per reply field
+struct RFState {
+    double rcin[12];
+    double m_airspeed_MPS;
+    double m_altitudeASL_MTR;
+    double m_altitudeAGL_MTR;
+    double m_groundspeed_MPS;
+    double m_pitchRate_DEGpSEC;
+    double m_rollRate_DEGpSEC;
+    double m_yawRate_DEGpSEC;
+    double m_azimuth_DEG;
+    double m_inclination_DEG;
+    double m_roll_DEG;
+    double m_aircraftPositionX_MTR;
+    double m_aircraftPositionY_MTR;
+    double m_velocityWorldU_MPS;
+    double m_velocityWorldV_MPS;
+    double m_velocityWorldW_MPS;
+    double m_velocityBodyU_MPS;
+    double m_velocityBodyV_MPS;
+    double m_velocityBodyW_MPS;
+    double m_accelerationWorldAX_MPS2;
+    double m_accelerationWorldAY_MPS2;
+    double m_accelerationWorldAZ_MPS2;
+    double m_accelerationBodyAX_MPS2;
+    double m_accelerationBodyAY_MPS2;
+    double m_accelerationBodyAZ_MPS2;
+    double m_windX_MPS;
+    double m_windY_MPS;
+    double m_windZ_MPS;
+    double m_propRPM;
+    double m_heliMainRotorRPM;
+    double m_batteryVoltage_VOLTS;
+    double m_batteryCurrentDraw_AMPS;
+    double m_batteryRemainingCapacity_MAH;
+    double m_fuelRemaining_OZ;
+    double m_isLocked;
+    double m_hasLostComponents;
+    double m_anEngineIsRunning;
+    double m_isTouchingGround;
+    double m_currentAircraftStatus;
+    double m_currentPhysicsTime_SEC;
+    double m_currentPhysicsSpeedMultiplier;
+    double m_orientationQuaternion_X;
+    double m_orientationQuaternion_Y;
+    double m_orientationQuaternion_Z;
+    double m_orientationQuaternion_W;
+    double m_flightAxisControllerIsActive;
+    double m_resetButtonHasBeenPressed;
+};
+
+// One published state frame
+struct StateFrame {
+    uint64_t seq;       // 1 for the first frame after construction, increments by one
+    int64_t stamp_ns;   // monotonic_ns() when the reply was parsed
+    RFState state;
+};
+
+} // namespace RF
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <string.h>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <climits>
+#include <iostream>
+
+namespace RF {
+
+// Scheduling for one of our threads. The defaults leave the thread alone.
+struct ThreadConfig {
+    int cpu;            // core to pin to, -1 to let it float
+    int fifo_priority;  // 1..99 to run SCHED_FIFO at that priority, 0 for SCHED_OTHER
+
+    ThreadConfig() : cpu(-1), fifo_priority(0) {}
+
+    bool is_default() const { return cpu < 0 && fifo_priority <= 0; }
+};
+
+// Name the thread and apply affinity / SCHED_FIFO. SCHED_FIFO needs CAP_SYS_NICE (or an
+// rtprio rlimit); failures are reported and the thread keeps running as it was.
+inline bool apply_thread_config(pthread_t thread, const ThreadConfig& cfg, const char* name) {
+    bool ok = true;
+
+    if (name) {
+        pthread_setname_np(thread, name);
+    }
+
+    if (cfg.cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cfg.cpu, &set);
+        int err = pthread_setaffinity_np(thread, sizeof(set), &set);
+        if (err != 0) {
+            std::cerr << "[WARN] " << name << ": failed to pin to CPU " << cfg.cpu << ": "
+                      << strerror(err) << std::endl;
+            ok = false;
+        }
+    }
+
+    if (cfg.fifo_priority > 0) {
+        struct sched_param sp;
+        memset(&sp, 0, sizeof(sp));
+        sp.sched_priority = cfg.fifo_priority;
+        int err = pthread_setschedparam(thread, SCHED_FIFO, &sp);
+        if (err != 0) {
+            std::cerr << "[WARN] " << name << ": failed to set SCHED_FIFO " << cfg.fifo_priority
+                      << ": " << strerror(err) << std::endl;
+            ok = false;
+        }
+    }
+
+    return ok;
+}
+
+// Lock current and future pages so the hot path never takes a page fault
+inline bool lock_memory() {
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        std::cerr << "[WARN] mlockall failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Touch every page of a buffer so it is resident before the first frame. Writes a
+// zero byte into each page (reading uninitialized memory back is undefined), so
+// use it on scratch buffers only.
+inline void prefault(void* buf, size_t len) {
+    volatile char* p = static_cast<volatile char*>(buf);
+    for (size_t i = 0; i < len; i += 4096) {
+        p[i] = 0;
+    }
+    if (len > 0) p[len - 1] = 0;
+}
+
+// Fault in the first 64 KiB of the calling thread's stack
+__attribute__((noinline)) inline void prefault_stack() {
+    char stack[64 * 1024];
+    prefault(stack, sizeof(stack));
+}
+
+// Running statistics of the interval between successive events (exchanges)
+class JitterStats {
+public:
+    JitterStats() { reset(); }
+
+    void reset() {
+        m_count = 0;
+        m_mean = 0.0;
+        m_m2 = 0.0;
+        m_min_ns = INT64_MAX;
+        m_max_ns = 0;
+    }
+
+    void add(int64_t interval_ns) {
+        // Welford's running mean/variance
+        m_count++;
+        double delta = interval_ns - m_mean;
+        m_mean += delta / m_count;
+        m_m2 += delta * (interval_ns - m_mean);
+        if (interval_ns < m_min_ns) m_min_ns = interval_ns;
+        if (interval_ns > m_max_ns) m_max_ns = interval_ns;
+    }
+
+    uint64_t count() const { return m_count; }
+    double mean_us() const { return m_mean / 1000.0; }
+    double stddev_us() const { return m_count > 1 ? std::sqrt(m_m2 / (m_count - 1)) / 1000.0 : 0.0; }
+    double min_us() const { return m_count ? m_min_ns / 1000.0 : 0.0; }
+    double max_us() const { return m_max_ns / 1000.0; }
+
+    void print(std::ostream& os, const char* label) const {
+        os << "[INFO] Exchange interval (" << label << "): n=" << m_count
+           << " mean=" << mean_us() << "us stddev=" << stddev_us()
+           << "us min=" << min_us() << "us max=" << max_us() << "us" << std::endl;
+    }
+
+private:
+    uint64_t m_count;
+    double m_mean;
+    double m_m2;
+    int64_t m_min_ns;
+    int64_t m_max_ns;
+};
+
+} // namespace RF
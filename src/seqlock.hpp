@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace RF {
+
+// Single-writer sequence lock. The writer never waits; readers copy the value and
+// retry if a write overlapped their copy, so they always get one consistent T.
+//
+// The payload is kept as relaxed atomic words so a racing read is well defined;
+// on x86/ARM these compile to plain loads and stores.
+template <typename T>
+class Seqlock {
+    static_assert(std::is_trivially_copyable<T>::value, "Seqlock payload must be trivially copyable");
+
+public:
+    Seqlock() : m_seq(0) {
+        for (size_t i = 0; i < WORDS; i++) {
+            m_words[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Writer side, one thread only
+    void store(const T& value) {
+        uint64_t words[WORDS];
+        words[WORDS - 1] = 0;
+        memcpy(words, &value, sizeof(T));
+
+        // Round up past an odd sequence left by a writer that died mid-store (one in
+        // another process), so readers still see this store as in progress
+        uint64_t seq = (m_seq.load(std::memory_order_relaxed) + 1) & ~(uint64_t)1;
+        m_seq.store(seq + 1, std::memory_order_relaxed);    // odd: write in progress
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < WORDS; i++) {
+            m_words[i].store(words[i], std::memory_order_relaxed);
+        }
+        m_seq.store(seq + 2, std::memory_order_release);
+    }
+
+    // Reader side, any number of threads. Returns the number of stores so far.
+    uint64_t load(T& out) const {
+        uint64_t words[WORDS];
+        uint64_t before, after;
+        do {
+            before = m_seq.load(std::memory_order_acquire);
+            for (size_t i = 0; i < WORDS; i++) {
+                words[i] = m_words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = m_seq.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+
+        memcpy(&out, words, sizeof(T));
+        return before / 2;
+    }
+
+    // load() that gives up after max_tries torn or in-progress copies rather than
+    // spinning, for a writer that may be preempted or dead (another process)
+    bool try_load(T& out, unsigned max_tries) const {
+        uint64_t words[WORDS];
+        for (unsigned tries = 0; tries < max_tries; tries++) {
+            uint64_t before = m_seq.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue;
+            }
+            for (size_t i = 0; i < WORDS; i++) {
+                words[i] = m_words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (m_seq.load(std::memory_order_relaxed) == before) {
+                memcpy(&out, words, sizeof(T));
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Number of completed stores, without copying the value
+    uint64_t version() const {
+        return m_seq.load(std::memory_order_acquire) / 2;
+    }
+
+private:
+    static const size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    alignas(64) std::atomic<uint64_t> m_seq;
+    std::atomic<uint64_t> m_words[WORDS];
+};
+
+} // namespace RF
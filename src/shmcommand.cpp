@@ -0,0 +1,206 @@
+#include <cstring>
+#include <new>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <iostream>
+
+#include "shmcommand.hpp"
+
+namespace RF {
+
+// Seqlock copies take() tries before reporting no new setpoint this exchange
+static const unsigned TAKE_TRIES = 64;
+
+ShmCommandChannel::ShmCommandChannel()
+    : m_header(nullptr),
+      m_taken_seq(0)
+{}
+
+
+ShmCommandChannel::~ShmCommandChannel() {
+    close();
+}
+
+
+bool ShmCommandChannel::create(const char* name) {
+    close();
+
+    shm_unlink(name);
+    // Owner only: whoever can write this segment flies the aircraft, so the writer
+    // has to run as the same user as RFInterface
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        std::cerr << "[ERROR] ShmCommand: shm_open " << name << " failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    if (ftruncate(fd, sizeof(ShmCommandHeader)) < 0) {
+        std::cerr << "[ERROR] ShmCommand: ftruncate failed: " << strerror(errno) << std::endl;
+        ::close(fd);
+        shm_unlink(name);
+        return false;
+    }
+
+    void* mem = mmap(nullptr, sizeof(ShmCommandHeader), PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, fd, 0);
+    ::close(fd);
+    if (mem == MAP_FAILED) {
+        std::cerr << "[ERROR] ShmCommand: mmap failed: " << strerror(errno) << std::endl;
+        shm_unlink(name);
+        return false;
+    }
+
+    m_header = new (mem) ShmCommandHeader();
+    m_header->version = ShmCommandHeader::VERSION;
+    m_header->setpoint_size = sizeof(Setpoint);
+    m_header->reader_pid = getpid();
+    m_header->writer_pid.store(0);
+
+    Setpoint neutral;
+    neutral.cmd = neutral_cmd();
+    neutral.stamp_ns = 0;
+    neutral.seq = 0;
+    m_header->setpoint.store(neutral);
+    m_header->magic.store(ShmCommandHeader::MAGIC, std::memory_order_release);
+
+    m_name = name;
+    m_taken_seq = 0;
+    return true;
+}
+
+
+void ShmCommandChannel::close() {
+    if (!m_header) {
+        return;
+    }
+    munmap(m_header, sizeof(ShmCommandHeader));
+    shm_unlink(m_name.c_str());
+    m_header = nullptr;
+}
+
+
+bool ShmCommandChannel::take(Setpoint& out, uint64_t& superseded) {
+    superseded = 0;
+    if (!m_header) {
+        return false;
+    }
+
+    // The writer is another process: if it is preempted or dies mid-store the
+    // sequence stays odd, and the exchange thread must not spin on it
+    Setpoint latest;
+    if (!m_header->setpoint.try_load(latest, TAKE_TRIES)) {
+        return false;
+    }
+    if (latest.seq == m_taken_seq) {
+        return false;
+    }
+    // A restarted writer starts counting again from 1
+    superseded = (latest.seq > m_taken_seq) ? latest.seq - m_taken_seq - 1 : 0;
+    m_taken_seq = latest.seq;
+    out = latest;
+    return true;
+}
+
+
+// A pid we can't signal (EPERM) still belongs to a live process
+static bool process_alive(int32_t pid) {
+    return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+
+ShmCommandWriter::ShmCommandWriter()
+    : m_header(nullptr),
+      m_seq(0)
+{}
+
+
+ShmCommandWriter::~ShmCommandWriter() {
+    detach();
+}
+
+
+bool ShmCommandWriter::attach(const char* name) {
+    detach();
+
+    int fd = shm_open(name, O_RDWR | O_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(ShmCommandHeader)) {
+        ::close(fd);
+        return false;
+    }
+
+    void* mem = mmap(nullptr, sizeof(ShmCommandHeader), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mem == MAP_FAILED) {
+        return false;
+    }
+
+    ShmCommandHeader* header = static_cast<ShmCommandHeader*>(mem);
+    if (header->magic.load(std::memory_order_acquire) != ShmCommandHeader::MAGIC ||
+        header->version != ShmCommandHeader::VERSION ||
+        header->setpoint_size != sizeof(Setpoint)) {
+        munmap(mem, sizeof(ShmCommandHeader));
+        return false;
+    }
+
+    // Claim the segment: only from no writer, or from one that died still attached
+    int32_t me = getpid();
+    int32_t owner = 0;
+    while (!header->writer_pid.compare_exchange_strong(owner, me)) {
+        if (owner == me || process_alive(owner)) {
+            std::cerr << "[ERROR] ShmCommand: " << name << " already has a writer (pid " << owner << ")" << std::endl;
+            munmap(mem, sizeof(ShmCommandHeader));
+            return false;
+        }
+    }
+    m_header = header;
+
+    // Carry on from whatever a previous writer left; if it died mid-store there is
+    // no telling, and the reader takes a lower seq as a restarted writer
+    Setpoint current;
+    m_seq = m_header->setpoint.try_load(current, 64) ? current.seq : 0;
+    return true;
+}
+
+
+void ShmCommandWriter::detach() {
+    if (m_header) {
+        int32_t me = getpid();
+        m_header->writer_pid.compare_exchange_strong(me, 0);
+        munmap(m_header, sizeof(ShmCommandHeader));
+    }
+    m_header = nullptr;
+}
+
+
+void ShmCommandWriter::publish(const RFCmd& cmd, int64_t stamp_ns) {
+    if (!m_header) {
+        return;
+    }
+    Setpoint sp;
+    sp.cmd = cmd;
+    sp.stamp_ns = stamp_ns;
+    sp.seq = ++m_seq;
+    m_header->setpoint.store(sp);
+}
+
+
+void ShmCommandWriter::publish_channels(uint32_t mask, const double values[RF_NUM_CHANNELS]) {
+    RFCmd cmd = neutral_cmd();
+    cmd.channel_mask = mask;
+    for (int i = 0; i < RF_NUM_CHANNELS; i++) {
+        cmd.channels[i] = values[i];
+    }
+    publish(cmd);
+}
+
+} // namespace RF
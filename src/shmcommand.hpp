@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "rfcmd.hpp"
+#include "commandslot.hpp"
+#include "seqlock.hpp"
+
+namespace RF {
+
+// Layout of the named POSIX shared-memory segment another process (our controller, a
+// SITL firmware bridge) writes control setpoints into. RFInterface creates it, mode
+// 0600; one writer process, running as the same user, attaches and publishes. The
+// exchange thread picks up the newest setpoint with a seqlock read - no syscalls, no
+// socket hop.
+struct ShmCommandHeader {
+    static const uint32_t MAGIC = 0x434d4652;   // "RFMC"
+    static const uint32_t VERSION = 2;       // 2: RFCmd::input_ns
+
+    std::atomic<uint32_t> magic;    // written last by the creator once the rest is valid
+    uint32_t version;
+    uint32_t setpoint_size;         // sizeof(Setpoint)
+    int32_t reader_pid;             // the RFInterface process
+    std::atomic<int32_t> writer_pid;
+
+    Seqlock<Setpoint> setpoint;
+};
+
+// RFInterface side: owns the segment and takes the newest setpoint each exchange
+class ShmCommandChannel {
+public:
+    ShmCommandChannel();
+    ~ShmCommandChannel();
+
+    // Create (or replace) the segment, e.g. "/rf_commands"
+    bool create(const char* name);
+    void close();
+    bool is_open() const { return m_header != nullptr; }
+
+    // Same contract as CommandSlot::take: false if nothing new, superseded counts the
+    // setpoints the writer published that were never taken. Never waits on the writer:
+    // a store still in progress after a few copies also reads as nothing new.
+    bool take(Setpoint& out, uint64_t& superseded);
+
+private:
+    std::string m_name;
+    ShmCommandHeader* m_header;
+    uint64_t m_taken_seq;
+};
+
+// Writer side, for the external process. Only one writer may be attached at a time:
+// attach() claims writer_pid and fails while another live process holds it.
+class ShmCommandWriter {
+public:
+    ShmCommandWriter();
+    ~ShmCommandWriter();
+
+    // Fails until RFInterface has created the segment
+    bool attach(const char* name);
+    void detach();
+    bool is_attached() const { return m_header != nullptr; }
+
+    void publish(const RFCmd& cmd, int64_t stamp_ns);
+    void publish(const RFCmd& cmd) { publish(cmd, monotonic_ns()); }
+
+    // Drive channels directly: bit i of mask selects values[i]
+    void publish_channels(uint32_t mask, const double values[RF_NUM_CHANNELS]);
+
+private:
+    ShmCommandHeader* m_header;
+    uint64_t m_seq;
+};
+
+} // namespace RF
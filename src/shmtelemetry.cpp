@@ -0,0 +1,236 @@
+#include <cstring>
+#include <climits>
+#include <new>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include <iostream>
+
+#include "shmtelemetry.hpp"
+#include "deadline.hpp"
+
+namespace RF {
+
+static size_t segment_size(uint32_t history) {
+    return sizeof(ShmTelemetryHeader) + (size_t)history * sizeof(Seqlock<StateFrame>);
+}
+
+static Seqlock<StateFrame>* history_of(ShmTelemetryHeader* header) {
+    return reinterpret_cast<Seqlock<StateFrame>*>(header + 1);
+}
+
+
+ShmTelemetryWriter::ShmTelemetryWriter()
+    : m_header(nullptr),
+      m_history(nullptr),
+      m_size(0)
+{}
+
+
+ShmTelemetryWriter::~ShmTelemetryWriter() {
+    close();
+}
+
+
+bool ShmTelemetryWriter::open(const char* name, uint32_t history) {
+    close();
+    if (history == 0) history = 1;
+
+    // Start from a fresh segment so readers of a previous run see it disappear
+    shm_unlink(name);
+    // Owner only: readers map it writable (they register as futex waiters), so a
+    // reader has to run as the same user anyway, and no other user should be able
+    // to scribble on the waiter count
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        std::cerr << "[ERROR] ShmTelemetry: shm_open " << name << " failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    size_t size = segment_size(history);
+    if (ftruncate(fd, size) < 0) {
+        std::cerr << "[ERROR] ShmTelemetry: ftruncate failed: " << strerror(errno) << std::endl;
+        ::close(fd);
+        shm_unlink(name);
+        return false;
+    }
+
+    void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    ::close(fd);
+    if (mem == MAP_FAILED) {
+        std::cerr << "[ERROR] ShmTelemetry: mmap failed: " << strerror(errno) << std::endl;
+        shm_unlink(name);
+        return false;
+    }
+
+    m_header = new (mem) ShmTelemetryHeader();
+    m_header->version = ShmTelemetryHeader::VERSION;
+    m_header->frame_size = sizeof(StateFrame);
+    m_header->history = history;
+    m_header->writer_pid = getpid();
+    m_header->futex_word.store(0);
+    m_header->waiters.store(0);
+
+    m_history = history_of(m_header);
+    for (uint32_t i = 0; i < history; i++) {
+        new (&m_history[i]) Seqlock<StateFrame>();
+    }
+    m_header->magic.store(ShmTelemetryHeader::MAGIC, std::memory_order_release);
+
+    m_name = name;
+    m_size = size;
+    return true;
+}
+
+
+void ShmTelemetryWriter::close() {
+    if (!m_header) {
+        return;
+    }
+    munmap(m_header, m_size);
+    shm_unlink(m_name.c_str());
+    m_header = nullptr;
+    m_history = nullptr;
+    m_size = 0;
+}
+
+
+void ShmTelemetryWriter::publish(const StateFrame& frame) {
+    if (!m_header) {
+        return;
+    }
+    m_history[frame.seq % m_header->history].store(frame);
+    m_header->latest.store(frame);
+
+    m_header->futex_word.fetch_add(1);
+    if (m_header->waiters.load() > 0) {
+        syscall(SYS_futex, &m_header->futex_word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+}
+
+
+// Seqlock copies a read tries before giving up: the writer is another process, and
+// if it dies mid-store the sequence stays odd for good
+static const unsigned READ_TRIES = 64;
+
+
+ShmTelemetryReader::ShmTelemetryReader()
+    : m_header(nullptr),
+      m_history(nullptr),
+      m_size(0)
+{}
+
+
+ShmTelemetryReader::~ShmTelemetryReader() {
+    detach();
+}
+
+
+bool ShmTelemetryReader::attach(const char* name) {
+    detach();
+
+    int fd = shm_open(name, O_RDWR | O_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(ShmTelemetryHeader)) {
+        ::close(fd);
+        return false;
+    }
+
+    // Reads go through the seqlocks; write access is only for the futex waiter count
+    void* mem = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mem == MAP_FAILED) {
+        return false;
+    }
+
+    ShmTelemetryHeader* header = static_cast<ShmTelemetryHeader*>(mem);
+    if (header->magic.load(std::memory_order_acquire) != ShmTelemetryHeader::MAGIC ||
+        header->version != ShmTelemetryHeader::VERSION ||
+        header->frame_size != sizeof(StateFrame) ||
+        segment_size(header->history) > (size_t)st.st_size) {
+        munmap(mem, st.st_size);
+        return false;
+    }
+
+    m_header = header;
+    m_history = history_of(header);
+    m_size = st.st_size;
+    return true;
+}
+
+
+void ShmTelemetryReader::detach() {
+    if (m_header) {
+        munmap(m_header, m_size);
+    }
+    m_header = nullptr;
+    m_history = nullptr;
+    m_size = 0;
+}
+
+
+uint64_t ShmTelemetryReader::latest(StateFrame& out) const {
+    if (!m_header) {
+        return 0;
+    }
+    if (!m_header->latest.try_load(out, READ_TRIES)) {
+        return 0;
+    }
+    return out.seq;
+}
+
+
+bool ShmTelemetryReader::read(uint64_t seq, StateFrame& out) const {
+    if (!m_header || seq == 0) {
+        return false;
+    }
+    return m_history[seq % m_header->history].try_load(out, READ_TRIES) && out.seq == seq;
+}
+
+
+uint64_t ShmTelemetryReader::wait_for_frame(uint64_t seq, uint32_t timeout_ms) {
+    if (!m_header) {
+        return 0;
+    }
+
+    StateFrame frame;
+    const Deadline deadline = Deadline::after_ms(timeout_ms);
+    uint64_t newest = 0;
+
+    m_header->waiters.fetch_add(1);
+    for (;;) {
+        uint32_t word = m_header->futex_word.load();
+        newest = latest(frame);
+        if (newest > seq) break;
+
+        int64_t left = deadline.remaining_ns();
+        if (left == 0) break;
+        struct timespec ts;
+        ts.tv_sec = left / 1000000000LL;
+        ts.tv_nsec = left % 1000000000LL;
+        syscall(SYS_futex, &m_header->futex_word, FUTEX_WAIT, word, &ts, nullptr, 0);
+    }
+    m_header->waiters.fetch_sub(1);
+    return newest;
+}
+
+
+uint32_t ShmTelemetryReader::history() const {
+    return m_header ? m_header->history : 0;
+}
+
+
+int ShmTelemetryReader::writer_pid() const {
+    return m_header ? m_header->writer_pid : 0;
+}
+
+} // namespace RF
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "rfstate.hpp"
+#include "seqlock.hpp"
+
+namespace RF {
+
+// Layout of the named POSIX shared-memory segment state frames are published into,
+// so other processes (autopilot, logger, GUI) running as the same user can read
+// telemetry without their own RealFlight connection. Mode 0600:
+//
+//   ShmTelemetryHeader
+//   Seqlock<StateFrame> history[header.history]
+//
+// The newest frame is in header.latest. Frame n is also kept in history[n % history]
+// until it is overwritten; the seq inside the frame tells a reader whether the slot
+// still holds the frame it asked for. Everything is read through seqlocks, so readers
+// never block the writer and only ever get a consistent frame; a read gives up rather
+// than spin on a writer that died mid-store.
+struct ShmTelemetryHeader {
+    static const uint32_t MAGIC = 0x4d544652;   // "RFTM"
+    static const uint32_t VERSION = 1;
+
+    std::atomic<uint32_t> magic;    // written last by the writer once the rest is valid
+    uint32_t version;
+    uint32_t frame_size;            // sizeof(StateFrame)
+    uint32_t history;               // number of history slots
+    int32_t writer_pid;
+
+    // Cross-process wakeups: bumped on every frame, waited on with a shared futex
+    std::atomic<uint32_t> futex_word;
+    std::atomic<uint32_t> waiters;
+
+    Seqlock<StateFrame> latest;
+};
+
+// Writer side, used by RFInterface on the update thread
+class ShmTelemetryWriter {
+public:
+    ShmTelemetryWriter();
+    ~ShmTelemetryWriter();
+
+    // Create (or replace) the segment. name is a POSIX shm name such as "/rf_telemetry".
+    bool open(const char* name, uint32_t history = 256);
+    void close();
+    bool is_open() const { return m_header != nullptr; }
+
+    void publish(const StateFrame& frame);
+
+private:
+    std::string m_name;
+    ShmTelemetryHeader* m_header;
+    Seqlock<StateFrame>* m_history;
+    size_t m_size;
+};
+
+// Reader side: map a segment published by another process. Zero-copy apart from the
+// seqlock copy into the caller's frame.
+class ShmTelemetryReader {
+public:
+    ShmTelemetryReader();
+    ~ShmTelemetryReader();
+
+    // Fails if the segment doesn't exist yet or was written by an incompatible build
+    bool attach(const char* name);
+    void detach();
+    bool is_attached() const { return m_header != nullptr; }
+
+    // Newest frame; returns its seq (0 if nothing has been published yet, or the
+    // writer has been stuck mid-store for longer than a few copies: it died)
+    uint64_t latest(StateFrame& out) const;
+
+    // Frame number seq from the history, false if it was already overwritten (or not
+    // published yet, or its slot is stuck mid-store)
+    bool read(uint64_t seq, StateFrame& out) const;
+
+    // Block until a frame newer than seq is published or timeout_ms passes. Returns
+    // the newest frame number.
+    uint64_t wait_for_frame(uint64_t seq, uint32_t timeout_ms);
+
+    uint32_t history() const;
+    int writer_pid() const;
+
+private:
+    ShmTelemetryHeader* m_header;
+    Seqlock<StateFrame>* m_history;
+    size_t m_size;
+};
+
+} // namespace RF
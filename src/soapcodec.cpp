@@ -0,0 +1,389 @@
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <cstdint>
+#include <cerrno>
+#include <sstream>
+
+#include "soapcodec.hpp"
+
+namespace RF {
+
+#define FIELD(tag, member) { tag, offsetof(RFState, member) }
+const StateField STATE_FIELDS[] = {
+    FIELD("m-airspeed-MPS", m_airspeed_MPS),
+    FIELD("m-altitudeASL-MTR", m_altitudeASL_MTR),
+    FIELD("m-altitudeAGL-MTR", m_altitudeAGL_MTR),
+    FIELD("m-groundspeed-MPS", m_groundspeed_MPS),
+    FIELD("m-pitchRate-DEGpSEC", m_pitchRate_DEGpSEC),
+    FIELD("m-rollRate-DEGpSEC", m_rollRate_DEGpSEC),
+    FIELD("m-yawRate-DEGpSEC", m_yawRate_DEGpSEC),
+    FIELD("m-azimuth-DEG", m_azimuth_DEG),
+    FIELD("m-inclination-DEG", m_inclination_DEG),
+    FIELD("m-roll-DEG", m_roll_DEG),
+    FIELD("m-aircraftPositionX-MTR", m_aircraftPositionX_MTR),
+    FIELD("m-aircraftPositionY-MTR", m_aircraftPositionY_MTR),
+    FIELD("m-velocityWorldU-MPS", m_velocityWorldU_MPS),
+    FIELD("m-velocityWorldV-MPS", m_velocityWorldV_MPS),
+    FIELD("m-velocityWorldW-MPS", m_velocityWorldW_MPS),
+    FIELD("m-velocityBodyU-MPS", m_velocityBodyU_MPS),
+    FIELD("m-velocityBodyV-MPS", m_velocityBodyV_MPS),
+    FIELD("m-velocityBodyW-MPS", m_velocityBodyW_MPS),
+    FIELD("m-accelerationWorldAX-MPS2", m_accelerationWorldAX_MPS2),
+    FIELD("m-accelerationWorldAY-MPS2", m_accelerationWorldAY_MPS2),
+    FIELD("m-accelerationWorldAZ-MPS2", m_accelerationWorldAZ_MPS2),
+    FIELD("m-accelerationBodyAX-MPS2", m_accelerationBodyAX_MPS2),
+    FIELD("m-accelerationBodyAY-MPS2", m_accelerationBodyAY_MPS2),
+    FIELD("m-accelerationBodyAZ-MPS2", m_accelerationBodyAZ_MPS2),
+    FIELD("m-windX-MPS", m_windX_MPS),
+    FIELD("m-windY-MPS", m_windY_MPS),
+    FIELD("m-windZ-MPS", m_windZ_MPS),
+    FIELD("m-propRPM", m_propRPM),
+    FIELD("m-heliMainRotorRPM", m_heliMainRotorRPM),
+    FIELD("m-batteryVoltage-VOLTS", m_batteryVoltage_VOLTS),
+    FIELD("m-batteryCurrentDraw-AMPS", m_batteryCurrentDraw_AMPS),
+    FIELD("m-batteryRemainingCapacity-MAH", m_batteryRemainingCapacity_MAH),
+    FIELD("m-fuelRemaining-OZ", m_fuelRemaining_OZ),
+    FIELD("m-isLocked", m_isLocked),
+    FIELD("m-hasLostComponents", m_hasLostComponents),
+    FIELD("m-anEngineIsRunning", m_anEngineIsRunning),
+    FIELD("m-isTouchingGround", m_isTouchingGround),
+    FIELD("m-currentAircraftStatus", m_currentAircraftStatus),
+    FIELD("m-currentPhysicsTime-SEC", m_currentPhysicsTime_SEC),
+    FIELD("m-currentPhysicsSpeedMultiplier", m_currentPhysicsSpeedMultiplier),
+    FIELD("m-orientationQuaternion-X", m_orientationQuaternion_X),
+    FIELD("m-orientationQuaternion-Y", m_orientationQuaternion_Y),
+    FIELD("m-orientationQuaternion-Z", m_orientationQuaternion_Z),
+    FIELD("m-orientationQuaternion-W", m_orientationQuaternion_W),
+    FIELD("m-flightAxisControllerIsActive", m_flightAxisControllerIsActive),
+    FIELD("m-resetButtonHasBeenPressed", m_resetButtonHasBeenPressed),
+};
+#undef FIELD
+const size_t NUM_STATE_FIELDS = sizeof(STATE_FIELDS) / sizeof(STATE_FIELDS[0]);
+
+static_assert(sizeof(STATE_FIELDS) / sizeof(STATE_FIELDS[0]) + RF_NUM_CHANNELS == sizeof(RFState) / sizeof(double),
+              "every RFState field needs a tag");
+static_assert(sizeof(STATE_FIELDS) / sizeof(STATE_FIELDS[0]) <= 64, "parse_state_scan tracks fields in a uint64_t");
+
+static const char CHANNELS_TAG[] = "<m-channelValues-0to1";
+
+static inline double& field_ref(RFState& state, size_t offset) {
+    return *(double*)((char*)&state + offset);
+}
+
+// Value text [start, end) as the original parser read it: true/false, else the
+// leading number, else 0
+static double parse_value(const char* start, const char* end) {
+    size_t len = end - start;
+    if (len == 4 && memcmp(start, "true", 4) == 0) return 1.0;
+    if (len == 5 && memcmp(start, "false", 5) == 0) return 0.0;
+
+    char* num_end;
+    errno = 0;
+    double value = strtod(start, &num_end);
+    if (num_end == start || num_end > end || errno == ERANGE) {
+        return 0.0;
+    }
+    return value;
+}
+
+
+// ---- parse_state_search ------------------------------------------------------------
+
+void parse_state_search(const char* reply, RFState& state) {
+    memset(&state, 0, sizeof(state));
+
+    // Lambda to extract values from xml tag
+    auto extract_value = [](const char* xml, const char* tag) -> double {
+        std::string search_tag = std::string("<") + tag + ">";
+        std::string end_tag = std::string("</") + tag + ">";
+
+        const char* start = strstr(xml, search_tag.c_str());
+        if (!start) return 0.0;
+
+        start += search_tag.length();
+        const char* end = strstr(start, end_tag.c_str());
+        if (!end) return 0.0;
+
+        return parse_value(start, end);
+    };
+
+    for (size_t i = 0; i < NUM_STATE_FIELDS; i++) {
+        field_ref(state, STATE_FIELDS[i].offset) = extract_value(reply, STATE_FIELDS[i].tag);
+    }
+
+    // Channel items in order
+    const char* p = strstr(reply, CHANNELS_TAG);
+    const char* list_end = p ? strstr(p, "</m-channelValues-0to1>") : nullptr;
+    for (int i = 0; p && list_end && i < RF_NUM_CHANNELS; i++) {
+        const char* item = strstr(p, "<item>");
+        if (!item || item > list_end) break;
+        item += 6;
+        const char* item_end = strstr(item, "</item>");
+        if (!item_end || item_end > list_end) break;
+        state.rcin[i] = parse_value(item, item_end);
+        p = item_end;
+    }
+}
+
+
+// ---- parse_state_scan --------------------------------------------------------------
+
+namespace {
+
+const size_t HASH_SLOTS = 128;      // power of two, > 2 * NUM_STATE_FIELDS
+
+inline uint32_t tag_hash(const char* s, size_t len) {
+    uint32_t h = 2166136261u;       // FNV-1a
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (uint8_t)s[i]) * 16777619u;
+    }
+    return h;
+}
+
+// Open-addressed tag -> field index table, built once
+struct FieldTable {
+    int16_t slot[HASH_SLOTS];       // index into STATE_FIELDS, -1 empty
+    uint8_t len[HASH_SLOTS];
+
+    FieldTable() {
+        for (size_t i = 0; i < HASH_SLOTS; i++) slot[i] = -1;
+        for (size_t f = 0; f < NUM_STATE_FIELDS; f++) {
+            size_t n = strlen(STATE_FIELDS[f].tag);
+            size_t h = tag_hash(STATE_FIELDS[f].tag, n) & (HASH_SLOTS - 1);
+            while (slot[h] >= 0) h = (h + 1) & (HASH_SLOTS - 1);
+            slot[h] = (int16_t)f;
+            len[h] = (uint8_t)n;
+        }
+    }
+
+    int find(const char* name, size_t n) const {
+        size_t h = tag_hash(name, n) & (HASH_SLOTS - 1);
+        while (slot[h] >= 0) {
+            if (len[h] == n && memcmp(STATE_FIELDS[slot[h]].tag, name, n) == 0) {
+                return slot[h];
+            }
+            h = (h + 1) & (HASH_SLOTS - 1);
+        }
+        return -1;
+    }
+};
+
+const FieldTable& field_table() {
+    static const FieldTable table;
+    return table;
+}
+
+// The closing tag for name right at p?
+inline bool closes(const char* p, const char* name, size_t n) {
+    return p[0] == '<' && p[1] == '/' && memcmp(p + 2, name, n) == 0 && p[2 + n] == '>';
+}
+
+} // namespace
+
+void parse_state_scan(const char* reply, RFState& state) {
+    const FieldTable& table = field_table();
+    memset(&state, 0, sizeof(state));
+
+    uint64_t seen = 0;              // first occurrence wins, as with strstr
+    int item = -1;                  // next rcin index while inside the channel list
+    const char* p = strchr(reply, '<');
+
+    while (p) {
+        const char* name = p + 1;
+        if (*name == '/' || *name == '?' || *name == '!') {
+            if (item >= 0 && strncmp(name, "/m-channelValues-0to1>", 22) == 0) {
+                item = RF_NUM_CHANNELS;     // list closed: no more items
+            }
+            p = strchr(name, '<');
+            continue;
+        }
+
+        // Tag name ends at '>' (plain tag) or whitespace (attributes)
+        const char* name_end = name;
+        while (*name_end && *name_end != '>' && *name_end != ' ' && *name_end != '/') name_end++;
+        if (!*name_end) break;
+        size_t n = name_end - name;
+
+        if (n == sizeof(CHANNELS_TAG) - 2 && memcmp(name, CHANNELS_TAG + 1, n) == 0) {
+            if (item < 0) item = 0;
+            p = strchr(name_end, '<');
+            continue;
+        }
+        if (*name_end != '>') {
+            p = strchr(name_end, '<');
+            continue;
+        }
+
+        const char* value = name_end + 1;
+        const char* value_end = strchr(value, '<');
+        if (!value_end) break;
+
+        if (n == 4 && memcmp(name, "item", 4) == 0) {
+            if (item >= 0 && item < RF_NUM_CHANNELS && closes(value_end, "item", 4)) {
+                state.rcin[item++] = parse_value(value, value_end);
+            }
+        } else if (value_end[1] == '/') {
+            int f = table.find(name, n);
+            if (f >= 0 && !(seen & (1ULL << f)) && closes(value_end, name, n)) {
+                seen |= 1ULL << f;
+                field_ref(state, STATE_FIELDS[f].offset) = parse_value(value, value_end);
+            }
+        }
+        p = value_end;
+    }
+}
+
+
+// ---- serializers -------------------------------------------------------------------
+
+void command_channels(const RFCmd& input, double channels[RF_NUM_CHANNELS]) {
+    // Map control inputs to channels (0.0 to 1.0 range)
+    for (int i = 0; i < RF_NUM_CHANNELS; i++) {
+        channels[i] = 0.5;
+    }
+    channels[7] = 0;    // Mode: Stability Control toggle. Different modes, order for different planes
+
+    // Map inputs to appropriate channels
+    channels[0] = input.aileron;   // Roll
+    channels[1] = input.elevator;  // Pitch
+    channels[2] = input.throttle;  // Throttle
+    channels[3] = input.rudder;    // Yaw
+    channels[4] = input.flaps;
+    channels[5] = input.gear;
+
+    // Raw channel setpoints win over the mapping
+    for (int i = 0; i < RF_NUM_CHANNELS; i++) {
+        if (input.channel_mask & (1u << i)) {
+            channels[i] = input.channels[i];
+        }
+    }
+}
+
+
+static const char CONTROLS_OPEN[] =
+    "<pControlInputs><m-selectedChannels>4095</m-selectedChannels><m-channelValues-0to1>";
+static const char CONTROLS_CLOSE[] = "</m-channelValues-0to1></pControlInputs>";
+
+
+void write_controls_stream(const RFCmd& input, std::string& out) {
+    double channels[RF_NUM_CHANNELS];
+    command_channels(input, channels);
+
+    std::stringstream body;
+    body << CONTROLS_OPEN;
+    for (int i = 0; i < RF_NUM_CHANNELS; i++) {
+        body << "<item>" << channels[i] << "</item>";
+    }
+    body << CONTROLS_CLOSE;
+    out = body.str();
+}
+
+
+size_t write_controls(const RFCmd& input, char* buf, size_t cap) {
+    double channels[RF_NUM_CHANNELS];
+    command_channels(input, channels);
+
+    size_t len = sizeof(CONTROLS_OPEN) - 1;
+    if (len >= cap) return cap;
+    memcpy(buf, CONTROLS_OPEN, len);
+
+    for (int i = 0; i < RF_NUM_CHANNELS; i++) {
+        // %g is what an ostream prints by default (6 significant digits)
+        int n = snprintf(buf + len, cap - len, "<item>%g</item>", channels[i]);
+        if (n < 0 || (size_t)n >= cap - len) return cap;
+        len += n;
+    }
+
+    size_t close_len = sizeof(CONTROLS_CLOSE) - 1;
+    if (len + close_len >= cap) return cap;
+    memcpy(buf + len, CONTROLS_CLOSE, close_len + 1);
+    return len + close_len;
+}
+
+
+static const char ENVELOPE_OPEN[] =
+    "<?xml version='1.0' encoding='UTF-8'?>"
+    "<soap:Envelope xmlns:soap='http://schemas.xmlsoap.org/soap/envelope/' "
+    "xmlns:xsd='http://www.w3.org/2001/XMLSchema' "
+    "xmlns:xsi='http://www.w3.org/2001/XMLSchema-instance'>"
+    "<soap:Body>";
+static const char ENVELOPE_CLOSE[] = "</soap:Body></soap:Envelope>";
+
+
+void write_request_stream(const char* action, const char* body, std::string& out) {
+    // Build SOAP envelope
+    std::stringstream envelope;
+    envelope << ENVELOPE_OPEN
+             << "<" << action << ">" << body << "</" << action << ">"
+             << ENVELOPE_CLOSE;
+
+    std::string envelope_str = envelope.str();
+
+    // Build HTTP request
+    std::stringstream request;
+    request << "POST / HTTP/1.1\r\n"
+            << "Soapaction: '" << action << "'\r\n"
+            << "Content-Length: " << envelope_str.length() << "\r\n"
+            << "Content-Type: text/xml;charset=utf-8\r\n"
+            << "\r\n"
+            << envelope_str;
+
+    out = request.str();
+}
+
+
+namespace {
+
+// Appends into a fixed buffer, remembering whether anything didn't fit
+struct BufferWriter {
+    char* buf;
+    size_t cap;
+    size_t len;
+
+    BufferWriter(char* b, size_t c) : buf(b), cap(c), len(0) {}
+
+    void add(const char* s, size_t n) {
+        if (len + n < cap) {
+            memcpy(buf + len, s, n);
+        }
+        len += n;
+    }
+    void add(const char* s) { add(s, strlen(s)); }
+
+    size_t finish() {
+        if (len >= cap) return cap;
+        buf[len] = '\0';
+        return len;
+    }
+};
+
+} // namespace
+
+size_t write_request(const char* action, const char* body, char* buf, size_t cap) {
+    size_t action_len = strlen(action);
+    size_t body_len = strlen(body);
+    size_t envelope_len = (sizeof(ENVELOPE_OPEN) - 1) + (2 * action_len + 5) + body_len + (sizeof(ENVELOPE_CLOSE) - 1);
+
+    char content_length[24];
+    int n = snprintf(content_length, sizeof(content_length), "%zu", envelope_len);
+
+    BufferWriter w(buf, cap);
+    w.add("POST / HTTP/1.1\r\nSoapaction: '");
+    w.add(action, action_len);
+    w.add("'\r\nContent-Length: ");
+    w.add(content_length, n);
+    w.add("\r\nContent-Type: text/xml;charset=utf-8\r\n\r\n");
+    w.add(ENVELOPE_OPEN, sizeof(ENVELOPE_OPEN) - 1);
+    w.add("<", 1);
+    w.add(action, action_len);
+    w.add(">", 1);
+    w.add(body, body_len);
+    w.add("</", 2);
+    w.add(action, action_len);
+    w.add(">", 1);
+    w.add(ENVELOPE_CLOSE, sizeof(ENVELOPE_CLOSE) - 1);
+    return w.finish();
+}
+
+} // namespace RF
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "rfcmd.hpp"
+#include "rfstate.hpp"
+
+namespace RF {
+
+// RFState field filled from the reply tag of the same name
+struct StateField {
+    const char* tag;
+    size_t offset;      // into RFState
+};
+
+// Every scalar field, in RFState order (rcin[] comes from the <item>s instead)
+extern const StateField STATE_FIELDS[];
+extern const size_t NUM_STATE_FIELDS;
+
+// ExchangeData reply parsers. reply is NUL terminated and may include the HTTP
+// header. Every field of state is written: values missing from the reply are 0,
+// true/false are 1/0 and anything else that isn't a number is 0. rcin[] are the
+// <item>s of m-channelValues-0to1 in order. All implementations give bit-identical
+// results (checked against the corpus in src/bench/corpus by rf_codec_bench).
+
+// One strstr per field, like the original parse_reply. Reference implementation.
+void parse_state_search(const char* reply, RFState& state);
+
+// Single pass over the tags with a hashed field lookup; no allocations
+void parse_state_scan(const char* reply, RFState& state);
+
+// Channel values sent for cmd: the mapped axes, then raw channel_mask overrides
+void command_channels(const RFCmd& cmd, double channels[RF_NUM_CHANNELS]);
+
+// ExchangeData body serializers, identical output
+
+// std::stringstream, like the original exchange_data. Reference implementation.
+void write_controls_stream(const RFCmd& cmd, std::string& out);
+
+// snprintf into buf; returns the length, or cap if it didn't fit. No allocations.
+size_t write_controls(const RFCmd& cmd, char* buf, size_t cap);
+
+// Complete HTTP POST for a SOAP action with body inside <action>, identical output
+
+// std::stringstream, like the original build_request. Reference implementation.
+void write_request_stream(const char* action, const char* body, std::string& out);
+
+// Straight into buf (NUL terminated); returns the length, or cap if it didn't fit.
+// No allocations.
+size_t write_request(const char* action, const char* body, char* buf, size_t cap);
+
+} // namespace RF
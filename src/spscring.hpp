@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace RF {
+
+// Bounded lock-free single-producer/single-consumer queue. The producer never waits:
+// when the consumer has fallen behind and the ring is full, push() drops the new
+// element and counts an overrun instead.
+template <typename T>
+class SpscRing {
+public:
+    // depth is rounded up to a power of two
+    explicit SpscRing(size_t depth)
+        : m_mask(round_up(depth) - 1),
+          m_buffer(m_mask + 1),
+          m_head(0),
+          m_cached_tail(0),
+          m_tail(0),
+          m_cached_head(0),
+          m_overruns(0)
+    {}
+
+    // Producer side
+    bool push(const T& value) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_cached_head > m_mask) {
+            m_cached_head = m_head.load(std::memory_order_acquire);
+            if (tail - m_cached_head > m_mask) {
+                m_overruns.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        }
+        m_buffer[tail & m_mask] = value;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false when empty.
+    bool pop(T& out) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_cached_tail) {
+            m_cached_tail = m_tail.load(std::memory_order_acquire);
+            if (head == m_cached_tail) {
+                return false;
+            }
+        }
+        out = m_buffer[head & m_mask];
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t size() const {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+    }
+    size_t capacity() const { return m_mask + 1; }
+
+    // Elements dropped because the ring was full
+    uint64_t overruns() const { return m_overruns.load(std::memory_order_relaxed); }
+
+private:
+    static size_t round_up(size_t n) {
+        size_t p = 1;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+    const size_t m_mask;
+    std::vector<T> m_buffer;
+
+    alignas(64) std::atomic<size_t> m_head;     // written by the consumer
+    size_t m_cached_tail;                       // consumer's view of m_tail
+    alignas(64) std::atomic<size_t> m_tail;     // written by the producer
+    size_t m_cached_head;                       // producer's view of m_head
+    alignas(64) std::atomic<uint64_t> m_overruns;
+};
+
+} // namespace RF
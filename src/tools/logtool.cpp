@@ -0,0 +1,709 @@
+// rf_logtool: look into recorded telemetry and pull time windows out of it, from
+// flight recorder files (*.rfrec, flightrecorder.hpp) and columnar frame logs
+// (*.rfcol, columnlog.hpp) alike.
+//
+// Usage: rf_logtool info FILE...
+//        rf_logtool index [--every N] FILE...
+//        rf_logtool export [--fields A,B,...] [--physics T0:T1] [--wall T0:T1]
+//                          [--format csv|raw] [--out PATH] [--every N] FILE...
+//
+//   info      one JSON line per file: format, frames, fields, size, time spans
+//   index     one JSON line per entry of the sparse time index
+//   export    the selected fields (default: all) of every frame in the window, as CSV
+//             (to stdout, or --out PATH) or as one raw little-endian array per field
+//             in PATH.<field>.<f64|i64|u64|u32>
+//   --physics window of m-currentPhysicsTime-SEC, --wall of seconds since the first
+//             frame of the first file; either end may be left out ("10:", ":2.5")
+//   --fields  field names as the file lists them ("info" prints them with --fields);
+//             an array field of a .rfrec ("rcin") stands for all its elements
+//   --every   .rfrec records per index entry (default 1024); a .rfcol is indexed
+//             by its blocks
+//
+// The index comes from a few bytes per entry: two values of every Nth record of a
+// .rfrec, the header of every block of a .rfcol. A window is found through it and
+// only the entries it overlaps are read, a chunk or a block at a time, so neither
+// command scans whole files or holds them in memory. Files given together (e.g.
+// rotated recordings) are taken in order, as one log.
+//
+// A .rfrec entry only knows the physics time at its two ends, so it is read whenever
+// the window overlaps that range or physics time went backwards across it (a
+// restart); a restart that climbs back past its earlier time within one entry can
+// hide frames from a --physics window.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <climits>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <vector>
+#include <string>
+#include <memory>
+#include <algorithm>
+
+#include "src/flightrecorder.hpp"
+#include "src/columnlog.hpp"
+
+using namespace RF;
+
+static const char PHYSICS_FIELD[] = "m-currentPhysicsTime-SEC";
+
+// One entry of the sparse index: a run of frames and the times it covers
+struct Span {
+    uint64_t pos;               // first record (.rfrec) or block offset (.rfcol)
+    uint64_t count;             // frames
+    double min_physics_s;
+    double max_physics_s;
+    int64_t first_ns;           // wall clock (monotonic_ns) of the first and last frame
+    int64_t last_ns;
+};
+
+struct TimeRange {
+    double physics_lo, physics_hi;
+    int64_t wall_lo, wall_hi;
+
+    TimeRange()
+        : physics_lo(-INFINITY), physics_hi(INFINITY), wall_lo(INT64_MIN), wall_hi(INT64_MAX)
+    {}
+
+    bool overlaps(const Span& s) const {
+        return s.max_physics_s >= physics_lo && s.min_physics_s <= physics_hi &&
+               s.last_ns >= wall_lo && s.first_ns <= wall_hi;
+    }
+
+    bool contains(double physics_s, int64_t wall_ns) const {
+        return physics_s >= physics_lo && physics_s <= physics_hi &&
+               wall_ns >= wall_lo && wall_ns <= wall_hi;
+    }
+};
+
+// A field as exported: name and RecordFieldType
+struct OutColumn {
+    std::string name;
+    uint16_t type;
+};
+
+struct Cell {
+    uint16_t type;
+    union {
+        double f;
+        int64_t i;
+        uint64_t u;
+    };
+};
+
+static const char* type_suffix(uint16_t type) {
+    switch (type) {
+    case FIELD_I64: return "i64";
+    case FIELD_U64: return "u64";
+    case FIELD_U32: return "u32";
+    default:        return "f64";
+    }
+}
+
+
+// Where exported rows go: CSV, or a raw array file per column
+class Output {
+public:
+    Output() : m_csv(nullptr), m_rows(0) {}
+
+    ~Output() {
+        if (m_csv && m_csv != stdout) fclose(m_csv);
+        for (size_t i = 0; i < m_raw.size(); i++) {
+            if (m_raw[i]) fclose(m_raw[i]);
+        }
+    }
+
+    bool open_csv(const char* path, const std::vector<OutColumn>& columns) {
+        m_csv = path ? fopen(path, "w") : stdout;
+        if (!m_csv) {
+            fprintf(stderr, "rf_logtool: can't create %s\n", path);
+            return false;
+        }
+        setvbuf(m_csv, nullptr, _IOFBF, 1 << 16);
+        for (size_t c = 0; c < columns.size(); c++) {
+            fprintf(m_csv, "%s%s", c ? "," : "", columns[c].name.c_str());
+        }
+        fputc('\n', m_csv);
+        return true;
+    }
+
+    bool open_raw(const char* prefix, const std::vector<OutColumn>& columns) {
+        for (size_t c = 0; c < columns.size(); c++) {
+            std::string path = std::string(prefix) + "." + columns[c].name + "." + type_suffix(columns[c].type);
+            FILE* f = fopen(path.c_str(), "wb");
+            if (!f) {
+                fprintf(stderr, "rf_logtool: can't create %s\n", path.c_str());
+                return false;
+            }
+            m_raw.push_back(f);
+        }
+        return true;
+    }
+
+    void row(const Cell* cells, size_t n) {
+        m_rows++;
+        if (m_csv) {
+            for (size_t c = 0; c < n; c++) {
+                if (c) fputc(',', m_csv);
+                switch (cells[c].type) {
+                case FIELD_F64: fprintf(m_csv, "%.17g", cells[c].f); break;
+                case FIELD_I64: fprintf(m_csv, "%lld", (long long)cells[c].i); break;
+                default:        fprintf(m_csv, "%llu", (unsigned long long)cells[c].u); break;
+                }
+            }
+            fputc('\n', m_csv);
+            return;
+        }
+        for (size_t c = 0; c < n; c++) {
+            if (cells[c].type == FIELD_U32) {
+                uint32_t v = (uint32_t)cells[c].u;
+                fwrite(&v, sizeof(v), 1, m_raw[c]);
+            } else {
+                fwrite(&cells[c].u, sizeof(cells[c].u), 1, m_raw[c]);
+            }
+        }
+    }
+
+    uint64_t rows() const { return m_rows; }
+
+private:
+    FILE* m_csv;
+    std::vector<FILE*> m_raw;
+    uint64_t m_rows;
+};
+
+
+// One log file of either format
+class LogFile {
+public:
+    virtual ~LogFile() {}
+
+    virtual const char* format() const = 0;
+    virtual uint64_t size_bytes() const = 0;
+
+    // Every exportable column, arrays flattened
+    const std::vector<OutColumn>& columns() const { return m_columns; }
+    int find_column(const std::string& name) const {
+        for (size_t i = 0; i < m_columns.size(); i++) {
+            if (m_columns[i].name == name) return (int)i;
+        }
+        return -1;
+    }
+
+    // The sparse index, from headers / sampled records only
+    virtual bool build_index(uint32_t every, std::vector<Span>& spans) = 0;
+
+    // Rows of span inside range, columns[] of them
+    virtual bool export_span(const Span& span, const TimeRange& range, const std::vector<int>& columns, Output& out) = 0;
+
+protected:
+    std::vector<OutColumn> m_columns;
+};
+
+
+// .rfrec: fixed-size records behind a header that describes them
+class RecordLog : public LogFile {
+public:
+    RecordLog() : m_fd(-1), m_size(0), m_records(0), m_physics_offset(0), m_wall_offset(0) {}
+    ~RecordLog() { if (m_fd >= 0) close(m_fd); }
+
+    bool open(const char* path) {
+        m_fd = ::open(path, O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (m_fd < 0 || fstat(m_fd, &st) != 0) return false;
+        m_size = st.st_size;
+
+        alignas(8) char buf[sizeof(RecordFileHeader)];
+        if (pread(m_fd, buf, sizeof(buf), 0) != (ssize_t)sizeof(buf)) return false;
+        const RecordFileHeader* h = (const RecordFileHeader*)buf;
+        if (memcmp(h->magic, "RFRECORD", 8) != 0 || h->version != RecordFileHeader::VERSION ||
+            h->record_size == 0 || h->num_fields == 0 || h->num_fields > 4096) {
+            return false;
+        }
+        m_header_size = h->header_size;
+        m_record_size = h->record_size;
+        m_records = h->records.load(std::memory_order_relaxed);
+        uint64_t fit = m_size > m_header_size ? (m_size - m_header_size) / m_record_size : 0;
+        if (m_records > fit) m_records = fit;      // count ahead of a truncated file
+
+        std::vector<RecordField> fields(h->num_fields);
+        size_t bytes = fields.size() * sizeof(RecordField);
+        if (pread(m_fd, fields.data(), bytes, sizeof(RecordFileHeader)) != (ssize_t)bytes) return false;
+
+        bool physics = false, wall = false;
+        for (size_t f = 0; f < fields.size(); f++) {
+            RecordField& field = fields[f];
+            field.name[sizeof(field.name) - 1] = '\0';
+            size_t elem = field.type == FIELD_U32 ? 4 : 8;
+            if (field.count == 0 || field.offset + field.count * elem > m_record_size) return false;
+            for (uint16_t i = 0; i < field.count; i++) {
+                OutColumn c;
+                c.name = field.name;
+                if (field.count > 1) {
+                    char suffix[16];
+                    snprintf(suffix, sizeof(suffix), "[%u]", i);
+                    c.name += suffix;
+                }
+                c.type = field.type;
+                m_columns.push_back(c);
+                m_offsets.push_back(field.offset + i * elem);
+            }
+            if (!strcmp(field.name, PHYSICS_FIELD) && field.type == FIELD_F64) {
+                m_physics_offset = field.offset;
+                physics = true;
+            }
+            if (!strcmp(field.name, "parsed_ns") && field.type == FIELD_I64) {
+                m_wall_offset = field.offset;
+                wall = true;
+            }
+        }
+        return physics && wall;
+    }
+
+    const char* format() const { return "rfrec"; }
+    uint64_t size_bytes() const { return m_size; }
+
+    bool build_index(uint32_t every, std::vector<Span>& spans) {
+        if (m_records == 0) return true;
+        if (every == 0) every = 1;
+
+        // Times of records 0, every, 2 * every, ... and the last one
+        std::vector<uint64_t> at;
+        for (uint64_t r = 0; r < m_records; r += every) at.push_back(r);
+        if (at.back() != m_records - 1) at.push_back(m_records - 1);
+        std::vector<double> physics(at.size());
+        std::vector<int64_t> wall(at.size());
+        for (size_t i = 0; i < at.size(); i++) {
+            uint64_t base = m_header_size + at[i] * m_record_size;
+            if (pread(m_fd, &physics[i], 8, base + m_physics_offset) != 8 ||
+                pread(m_fd, &wall[i], 8, base + m_wall_offset) != 8) {
+                return false;
+            }
+        }
+
+        // Entry i runs from sample i up to sample i + 1; the last one takes in the last record
+        size_t entries = at.size() > 1 ? at.size() - 1 : 1;
+        for (size_t i = 0; i < entries; i++) {
+            size_t j = std::min(i + 1, at.size() - 1);
+            Span s;
+            s.pos = at[i];
+            s.count = (i + 1 == entries) ? m_records - at[i] : at[j] - at[i];
+            s.first_ns = wall[i];
+            s.last_ns = wall[j];
+            if (physics[j] < physics[i]) {
+                // Restarted somewhere in between: could hold any time
+                s.min_physics_s = -INFINITY;
+                s.max_physics_s = INFINITY;
+            } else {
+                s.min_physics_s = physics[i];
+                s.max_physics_s = physics[j];
+            }
+            spans.push_back(s);
+        }
+        return true;
+    }
+
+    bool export_span(const Span& span, const TimeRange& range, const std::vector<int>& columns, Output& out) {
+        const size_t CHUNK = 256;
+        m_chunk.resize(CHUNK * m_record_size);
+        std::vector<Cell> cells(columns.size());
+
+        for (uint64_t r = span.pos; r < span.pos + span.count; r += CHUNK) {
+            size_t n = (size_t)std::min<uint64_t>(CHUNK, span.pos + span.count - r);
+            size_t bytes = n * m_record_size;
+            if (pread(m_fd, m_chunk.data(), bytes, m_header_size + r * m_record_size) != (ssize_t)bytes) {
+                return false;
+            }
+            for (size_t k = 0; k < n; k++) {
+                const char* rec = m_chunk.data() + k * m_record_size;
+                double physics;
+                int64_t wall;
+                memcpy(&physics, rec + m_physics_offset, 8);
+                memcpy(&wall, rec + m_wall_offset, 8);
+                if (!range.contains(physics, wall)) continue;
+
+                for (size_t c = 0; c < columns.size(); c++) {
+                    Cell& cell = cells[c];
+                    cell.type = m_columns[columns[c]].type;
+                    cell.u = 0;
+                    memcpy(&cell.u, rec + m_offsets[columns[c]], cell.type == FIELD_U32 ? 4 : 8);
+                }
+                out.row(cells.data(), cells.size());
+            }
+        }
+        return true;
+    }
+
+private:
+    int m_fd;
+    uint64_t m_size;
+    uint32_t m_header_size;
+    uint32_t m_record_size;
+    uint64_t m_records;
+    uint32_t m_physics_offset;
+    uint32_t m_wall_offset;
+    std::vector<uint32_t> m_offsets;
+    std::vector<char> m_chunk;
+};
+
+
+// .rfcol: blocks of compressed columns, each decodable alone
+class ColumnLog : public LogFile {
+public:
+    ColumnLog() : m_size(0), m_physics_col(-1), m_wall_col(-1) {}
+
+    bool open(const char* path) {
+        struct stat st;
+        if (stat(path, &st) != 0 || !m_reader.open(path)) return false;
+        m_size = st.st_size;
+        for (size_t c = 0; c < m_reader.num_columns(); c++) {
+            OutColumn col;
+            col.name = m_reader.column(c).name;
+            col.type = m_reader.column(c).type == COLUMN_DELTA ? FIELD_I64 : FIELD_F64;
+            m_columns.push_back(col);
+        }
+        m_physics_col = m_reader.find_column(PHYSICS_FIELD);
+        m_wall_col = m_reader.find_column("stamp_ns");
+        return m_physics_col >= 0 && m_wall_col >= 0 &&
+               m_reader.column(m_wall_col).type == COLUMN_DELTA;
+    }
+
+    const char* format() const { return "rfcol"; }
+    uint64_t size_bytes() const { return m_size; }
+
+    bool build_index(uint32_t, std::vector<Span>& spans) {
+        ColumnBlockInfo b;
+        while (m_reader.next_block(b)) {
+            if (b.frames == 0) continue;
+            Span s;
+            s.pos = b.offset;
+            s.count = b.frames;
+            s.min_physics_s = b.min_physics_s;
+            s.max_physics_s = b.max_physics_s;
+            s.first_ns = b.first_stamp_ns;
+            s.last_ns = b.last_stamp_ns;
+            spans.push_back(s);
+        }
+        return true;
+    }
+
+    bool export_span(const Span& span, const TimeRange& range, const std::vector<int>& columns, Output& out) {
+        ColumnBlockInfo b;
+        if (!m_reader.seek_block(span.pos, b)) return false;
+
+        // Only the columns asked for, plus the two times
+        if (!m_reader.read_column(m_physics_col, m_physics) || !m_reader.read_column(m_wall_col, m_wall)) {
+            return false;
+        }
+        m_values.resize(columns.size());
+        for (size_t c = 0; c < columns.size(); c++) {
+            bool ok = m_columns[columns[c]].type == FIELD_I64 ?
+                m_reader.read_column(columns[c], m_values[c].i) : m_reader.read_column(columns[c], m_values[c].f);
+            if (!ok) return false;
+        }
+
+        std::vector<Cell> cells(columns.size());
+        for (size_t k = 0; k < b.frames; k++) {
+            if (!range.contains(m_physics[k], m_wall[k])) continue;
+            for (size_t c = 0; c < columns.size(); c++) {
+                cells[c].type = m_columns[columns[c]].type;
+                if (cells[c].type == FIELD_I64) cells[c].i = m_values[c].i[k];
+                else cells[c].f = m_values[c].f[k];
+            }
+            out.row(cells.data(), cells.size());
+        }
+        return true;
+    }
+
+private:
+    struct Values {
+        std::vector<double> f;
+        std::vector<int64_t> i;
+    };
+
+    ColumnLogReader m_reader;
+    uint64_t m_size;
+    int m_physics_col;
+    int m_wall_col;
+    std::vector<double> m_physics;
+    std::vector<int64_t> m_wall;
+    std::vector<Values> m_values;
+};
+
+
+static std::unique_ptr<LogFile> open_log(const char* path) {
+    char magic[8] = { 0 };
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "rf_logtool: can't open %s\n", path);
+        return nullptr;
+    }
+    ssize_t n = read(fd, magic, sizeof(magic));
+    close(fd);
+
+    if (n == (ssize_t)sizeof(magic) && !memcmp(magic, "RFRECORD", 8)) {
+        std::unique_ptr<RecordLog> log(new RecordLog());
+        if (log->open(path)) return std::unique_ptr<LogFile>(log.release());
+    } else if (n == (ssize_t)sizeof(magic) && !memcmp(magic, "RFCOLLOG", 8)) {
+        std::unique_ptr<ColumnLog> log(new ColumnLog());
+        if (log->open(path)) return std::unique_ptr<LogFile>(log.release());
+    }
+    fprintf(stderr, "rf_logtool: %s is not a flight recording or frame log this tool can read\n", path);
+    return nullptr;
+}
+
+
+struct Options {
+    std::vector<const char*> files;
+    std::vector<std::string> fields;
+    bool list_fields;
+    const char* physics;
+    const char* wall;
+    const char* out;
+    bool raw;
+    uint32_t every;
+};
+
+// "A:B", "A:", ":B" -> [lo, hi]; false if malformed
+static bool parse_window(const char* arg, double& lo, double& hi) {
+    const char* colon = strchr(arg, ':');
+    if (!colon) return false;
+    char* end;
+    if (colon != arg) {
+        lo = strtod(arg, &end);
+        if (end != colon) return false;
+    }
+    if (colon[1]) {
+        hi = strtod(colon + 1, &end);
+        if (*end) return false;
+    }
+    return lo <= hi;
+}
+
+static void split(const char* list, std::vector<std::string>& out) {
+    for (const char* p = list; *p; ) {
+        const char* comma = strchr(p, ',');
+        size_t len = comma ? (size_t)(comma - p) : strlen(p);
+        if (len) out.push_back(std::string(p, len));
+        p += len + (comma ? 1 : 0);
+    }
+}
+
+// The wall clock of the first frame of the first file with any
+static int64_t first_wall_ns(const std::vector<std::vector<Span> >& indexes) {
+    for (size_t f = 0; f < indexes.size(); f++) {
+        if (!indexes[f].empty()) return indexes[f][0].first_ns;
+    }
+    return 0;
+}
+
+
+static int cmd_info(const Options& opt, std::vector<std::unique_ptr<LogFile> >& logs,
+                    const std::vector<std::vector<Span> >& indexes) {
+    int64_t base = first_wall_ns(indexes);
+    for (size_t f = 0; f < logs.size(); f++) {
+        const std::vector<Span>& spans = indexes[f];
+        uint64_t frames = 0;
+        double lo = INFINITY, hi = -INFINITY;
+        for (size_t i = 0; i < spans.size(); i++) {
+            frames += spans[i].count;
+            if (std::isfinite(spans[i].min_physics_s)) lo = std::min(lo, spans[i].min_physics_s);
+            if (std::isfinite(spans[i].max_physics_s)) hi = std::max(hi, spans[i].max_physics_s);
+        }
+        printf("{\"file\":\"%s\",\"format\":\"%s\",\"bytes\":%llu,\"frames\":%llu,\"bytes_per_frame\":%.1f,"
+               "\"columns\":%zu,\"index_entries\":%zu",
+               opt.files[f], logs[f]->format(), (unsigned long long)logs[f]->size_bytes(),
+               (unsigned long long)frames, frames ? (double)logs[f]->size_bytes() / frames : 0.0,
+               logs[f]->columns().size(), spans.size());
+        if (!spans.empty()) {
+            printf(",\"wall_s\":[%.6f,%.6f],\"physics_s\":[%.6f,%.6f]",
+                   (spans.front().first_ns - base) / 1e9, (spans.back().last_ns - base) / 1e9,
+                   std::isfinite(lo) ? lo : 0.0, std::isfinite(hi) ? hi : 0.0);
+        }
+        if (opt.list_fields) {
+            printf(",\"fields\":[");
+            for (size_t c = 0; c < logs[f]->columns().size(); c++) {
+                printf("%s\"%s\"", c ? "," : "", logs[f]->columns()[c].name.c_str());
+            }
+            printf("]");
+        }
+        printf("}\n");
+    }
+    return 0;
+}
+
+
+static int cmd_index(const Options& opt, const std::vector<std::vector<Span> >& indexes) {
+    int64_t base = first_wall_ns(indexes);
+    for (size_t f = 0; f < indexes.size(); f++) {
+        for (size_t i = 0; i < indexes[f].size(); i++) {
+            const Span& s = indexes[f][i];
+            printf("{\"file\":\"%s\",\"entry\":%zu,\"pos\":%llu,\"frames\":%llu,\"wall_s\":[%.6f,%.6f],"
+                   "\"physics_s\":[%.6f,%.6f]}\n",
+                   opt.files[f], i, (unsigned long long)s.pos, (unsigned long long)s.count,
+                   (s.first_ns - base) / 1e9, (s.last_ns - base) / 1e9,
+                   std::isfinite(s.min_physics_s) ? s.min_physics_s : -1.0,
+                   std::isfinite(s.max_physics_s) ? s.max_physics_s : -1.0);
+        }
+    }
+    return 0;
+}
+
+
+static int cmd_export(const Options& opt, std::vector<std::unique_ptr<LogFile> >& logs,
+                      const std::vector<std::vector<Span> >& indexes) {
+    TimeRange range;
+    if (opt.physics && !parse_window(opt.physics, range.physics_lo, range.physics_hi)) {
+        fprintf(stderr, "rf_logtool: bad --physics window %s\n", opt.physics);
+        return 1;
+    }
+    if (opt.wall) {
+        double lo = -INFINITY, hi = INFINITY;
+        if (!parse_window(opt.wall, lo, hi)) {
+            fprintf(stderr, "rf_logtool: bad --wall window %s\n", opt.wall);
+            return 1;
+        }
+        int64_t base = first_wall_ns(indexes);
+        if (std::isfinite(lo)) range.wall_lo = base + (int64_t)llround(lo * 1e9);
+        if (std::isfinite(hi)) range.wall_hi = base + (int64_t)llround(hi * 1e9);
+    }
+
+    // Columns by name, in the first file's terms; every file must have them
+    std::vector<OutColumn> out_columns;
+    const std::vector<OutColumn>& all = logs[0]->columns();
+    if (opt.fields.empty()) {
+        out_columns = all;
+    }
+    for (size_t i = 0; i < opt.fields.size(); i++) {
+        const std::string& name = opt.fields[i];
+        size_t before = out_columns.size();
+        if (logs[0]->find_column(name) >= 0) {
+            out_columns.push_back(all[logs[0]->find_column(name)]);
+        } else {
+            for (size_t c = 0; c < all.size(); c++) {
+                if (all[c].name.compare(0, name.size() + 1, name + "[") == 0) out_columns.push_back(all[c]);
+            }
+        }
+        if (out_columns.size() == before) {
+            fprintf(stderr, "rf_logtool: no field %s in %s\n", name.c_str(), opt.files[0]);
+            return 1;
+        }
+    }
+    std::vector<std::vector<int> > columns(logs.size());
+    for (size_t f = 0; f < logs.size(); f++) {
+        for (size_t c = 0; c < out_columns.size(); c++) {
+            int col = logs[f]->find_column(out_columns[c].name);
+            if (col < 0 || logs[f]->columns()[col].type != out_columns[c].type) {
+                fprintf(stderr, "rf_logtool: no field %s in %s\n", out_columns[c].name.c_str(), opt.files[f]);
+                return 1;
+            }
+            columns[f].push_back(col);
+        }
+    }
+
+    Output out;
+    if (opt.raw ? !out.open_raw(opt.out, out_columns) : !out.open_csv(opt.out, out_columns)) {
+        return 1;
+    }
+
+    uint64_t read_frames = 0;
+    for (size_t f = 0; f < logs.size(); f++) {
+        const std::vector<Span>& spans = indexes[f];
+
+        // Wall time only grows: skip straight to the first entry that can be in range
+        size_t lo = 0, hi = spans.size();
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (spans[mid].last_ns < range.wall_lo) lo = mid + 1; else hi = mid;
+        }
+        for (size_t i = lo; i < spans.size() && spans[i].first_ns <= range.wall_hi; i++) {
+            if (!range.overlaps(spans[i])) continue;
+            read_frames += spans[i].count;
+            if (!logs[f]->export_span(spans[i], range, columns[f], out)) {
+                fprintf(stderr, "rf_logtool: can't read %s\n", opt.files[f]);
+                return 1;
+            }
+        }
+    }
+    fprintf(stderr, "rf_logtool: %llu frames exported, %llu read\n",
+            (unsigned long long)out.rows(), (unsigned long long)read_frames);
+    return 0;
+}
+
+
+static void usage() {
+    fprintf(stderr, "usage: rf_logtool info [--fields] FILE...\n"
+                    "       rf_logtool index [--every N] FILE...\n"
+                    "       rf_logtool export [--fields A,B,...] [--physics T0:T1] [--wall T0:T1]\n"
+                    "                         [--format csv|raw] [--out PATH] [--every N] FILE...\n");
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        usage();
+        return 1;
+    }
+    std::string command = argv[1];
+    if (command != "info" && command != "index" && command != "export") {
+        usage();
+        return 1;
+    }
+
+    Options opt;
+    opt.list_fields = false;
+    opt.physics = nullptr;
+    opt.wall = nullptr;
+    opt.out = nullptr;
+    opt.raw = false;
+    opt.every = 1024;
+
+    for (int i = 2; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strncmp(arg, "--", 2) != 0) {
+            opt.files.push_back(arg);
+            continue;
+        }
+        if (command == "info" && !strcmp(arg, "--fields")) {
+            opt.list_fields = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage();
+            return 1;
+        }
+        const char* value = argv[++i];
+        if (!strcmp(arg, "--fields")) split(value, opt.fields);
+        else if (!strcmp(arg, "--physics")) opt.physics = value;
+        else if (!strcmp(arg, "--wall")) opt.wall = value;
+        else if (!strcmp(arg, "--out")) opt.out = value;
+        else if (!strcmp(arg, "--every")) opt.every = strtoul(value, nullptr, 10);
+        else if (!strcmp(arg, "--format") && !strcmp(value, "csv")) opt.raw = false;
+        else if (!strcmp(arg, "--format") && !strcmp(value, "raw")) opt.raw = true;
+        else {
+            usage();
+            return 1;
+        }
+    }
+    if (opt.files.empty() || (opt.raw && !opt.out)) {
+        usage();
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<LogFile> > logs;
+    std::vector<std::vector<Span> > indexes(opt.files.size());
+    for (size_t f = 0; f < opt.files.size(); f++) {
+        logs.push_back(open_log(opt.files[f]));
+        if (!logs.back() || !logs.back()->build_index(opt.every, indexes[f])) {
+            if (logs.back()) fprintf(stderr, "rf_logtool: can't index %s\n", opt.files[f]);
+            return 1;
+        }
+    }
+
+    if (command == "info") return cmd_info(opt, logs, indexes);
+    if (command == "index") return cmd_index(opt, indexes);
+    return cmd_export(opt, logs, indexes);
+}
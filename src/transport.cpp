@@ -0,0 +1,65 @@
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <strings.h>
+
+#include <iostream>
+
+#include "transport.hpp"
+#include "epolltransport.hpp"
+#include "uringtransport.hpp"
+
+namespace RF {
+
+static const char SOAP_END_TAG[] = "</SOAP-ENV:Envelope>";
+
+std::unique_ptr<Transport> make_transport(TransportKind kind) {
+    if (kind != TRANSPORT_EPOLL) {
+        if (UringTransport::supported()) {
+            return std::unique_ptr<Transport>(new UringTransport());
+        }
+        if (kind == TRANSPORT_URING) {
+            std::cerr << "[WARN] Transport: io_uring not supported here, using epoll" << std::endl;
+        }
+    }
+    return std::unique_ptr<Transport>(new EpollTransport());
+}
+
+
+void ReplyFramer::reset() {
+    header_len = 0;
+    content_len = SIZE_MAX;
+}
+
+
+bool ReplyFramer::complete(const char* buf, size_t received, size_t prev_received) {
+    if (header_len == 0) {
+        size_t from = prev_received > 3 ? prev_received - 3 : 0;
+        const char* hdr_end = strstr(buf + from, "\r\n\r\n");
+        if (!hdr_end) {
+            return false;
+        }
+        header_len = (hdr_end - buf) + 4;
+
+        for (const char* line = buf; line < hdr_end; ) {
+            if (strncasecmp(line, "Content-Length:", 15) == 0) {
+                content_len = strtoul(line + 15, nullptr, 10);
+                break;
+            }
+            const char* next = strstr(line, "\r\n");
+            if (!next) break;
+            line = next + 2;
+        }
+        prev_received = header_len;
+    }
+
+    if (content_len != SIZE_MAX) {
+        return received >= header_len + content_len;
+    }
+
+    size_t tag_len = sizeof(SOAP_END_TAG) - 1;
+    size_t from = prev_received > tag_len ? prev_received - tag_len : 0;
+    return strstr(buf + from, SOAP_END_TAG) != nullptr;
+}
+
+} // namespace RF
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <sys/types.h>
+
+#include "deadline.hpp"
+
+namespace RF {
+
+// Phase boundaries of an exchange (monotonic_ns()), 0 where the backend can't see one
+struct ExchangeTimes {
+    int64_t start;          // exchange started
+    int64_t connected;      // connection usable (== start on a pre-opened one)
+    int64_t sent;           // request fully written
+    int64_t first_byte;     // first reply bytes arrived
+    int64_t done;           // reply complete, or the exchange failed
+};
+
+// Size of the buffer RFInterface receives replies into, NUL included
+static const size_t MAX_REPLY_BYTES = 10000;
+
+// Request/reply transport for SOAP-over-HTTP. RealFlight accepts one request per
+// connection, so every exchange is connect -> send -> receive -> close.
+class Transport {
+public:
+    virtual ~Transport() {}
+
+    virtual const char* name() const = 0;
+
+    // Returns an endpoint id, or -1 on a bad address / too many endpoints. prewarm is
+    // the number of connections to keep pre-opened, for backends that support it.
+    virtual int add_endpoint(const char* ip, uint16_t port, size_t prewarm) = 0;
+
+    // Blocking exchange on a fresh connection, finished by deadline whatever phase it
+    // is in. Returns the reply length (reply is NUL terminated), or a negative errno
+    // (-ETIMEDOUT once the deadline passes). Only a reply ReplyFramer saw end counts:
+    // the server closing early is -ECONNRESET, one too big for reply_cap -EMSGSIZE.
+    virtual ssize_t exchange(int endpoint, const char* data, size_t len,
+                             char* reply, size_t reply_cap, const Deadline& deadline) = 0;
+
+    // Syscalls made on behalf of exchanges and exchanges finished (ok or not) since
+    // construction, so backends can be compared on syscalls per exchange
+    uint64_t syscalls() const { return m_syscalls; }
+    uint64_t exchanges() const { return m_exchanges; }
+
+    // Phase boundaries of the last exchange to finish
+    const ExchangeTimes& last_times() const { return m_times; }
+
+protected:
+    Transport() : m_syscalls(0), m_exchanges(0) {
+        m_times.start = m_times.connected = m_times.sent = m_times.first_byte = m_times.done = 0;
+    }
+
+    uint64_t m_syscalls;
+    uint64_t m_exchanges;
+    ExchangeTimes m_times;
+};
+
+enum TransportKind {
+    TRANSPORT_AUTO,     // io_uring when the kernel supports it, epoll otherwise
+    TRANSPORT_EPOLL,
+    TRANSPORT_URING
+};
+
+// Create the requested backend. TRANSPORT_URING falls back to epoll (with a warning)
+// if io_uring is unavailable or blocked.
+std::unique_ptr<Transport> make_transport(TransportKind kind = TRANSPORT_AUTO);
+
+// Transport policies for BasicRFInterface. A policy is any class with name(),
+// add_endpoint(), exchange(), syscalls(), exchanges() and last_times() as above; every final
+// Transport subclass is one, and calls through it compile to direct calls.
+//
+// AutoTransport is the default: the backend is picked at runtime by make_transport(),
+// at the cost of one virtual call per exchange.
+class AutoTransport {
+public:
+    explicit AutoTransport(TransportKind kind = TRANSPORT_AUTO) : m_impl(make_transport(kind)) {}
+
+    const char* name() const { return m_impl->name(); }
+
+    int add_endpoint(const char* ip, uint16_t port, size_t prewarm) {
+        return m_impl->add_endpoint(ip, port, prewarm);
+    }
+
+    ssize_t exchange(int endpoint, const char* data, size_t len,
+                     char* reply, size_t reply_cap, const Deadline& deadline) {
+        return m_impl->exchange(endpoint, data, len, reply, reply_cap, deadline);
+    }
+
+    uint64_t syscalls() const { return m_impl->syscalls(); }
+    uint64_t exchanges() const { return m_impl->exchanges(); }
+    const ExchangeTimes& last_times() const { return m_impl->last_times(); }
+
+    Transport& backend() { return *m_impl; }
+
+private:
+    std::unique_ptr<Transport> m_impl;
+};
+
+// Tracks where an HTTP reply ends as bytes arrive: Content-Length bytes after the
+// header, or without a Content-Length, the closing SOAP envelope tag.
+struct ReplyFramer {
+    size_t header_len;      // 0 until the header terminator has been seen
+    size_t content_len;     // SIZE_MAX if the reply has no Content-Length
+
+    ReplyFramer() { reset(); }
+    void reset();
+
+    // buf holds received bytes (NUL terminated), prev_received of which were
+    // already checked by an earlier call
+    bool complete(const char* buf, size_t received, size_t prev_received);
+};
+
+} // namespace RF
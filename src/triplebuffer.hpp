@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace RF {
+
+// Wait-free single-producer/single-consumer handoff of the latest T. The writer fills
+// its private buffer and publishes it by swapping it with the shared middle one; the
+// reader swaps the middle one into its private buffer when something new is there.
+// Neither side ever waits for the other and the reader always sees a complete T.
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : m_write(0), m_middle(1), m_read(2) {}
+
+    explicit TripleBuffer(const T& initial) : m_write(0), m_middle(1), m_read(2) {
+        m_buffers[0] = m_buffers[1] = m_buffers[2] = initial;
+    }
+
+    // Writer side: fill this, then publish()
+    T& write_buffer() { return m_buffers[m_write]; }
+
+    void publish() {
+        uint8_t old = m_middle.exchange(m_write | DIRTY, std::memory_order_acq_rel);
+        m_write = old & INDEX;
+    }
+
+    // Reader side: take the newest published value if there is one. Returns true if
+    // read() changed.
+    bool update() {
+        if (!(m_middle.load(std::memory_order_relaxed) & DIRTY)) {
+            return false;
+        }
+        uint8_t old = m_middle.exchange(m_read, std::memory_order_acq_rel);
+        m_read = old & INDEX;
+        return true;
+    }
+
+    const T& read() const { return m_buffers[m_read]; }
+
+private:
+    static const uint8_t INDEX = 0x3;
+    static const uint8_t DIRTY = 0x4;
+
+    T m_buffers[3];
+    uint8_t m_write;                    // writer only
+    alignas(64) std::atomic<uint8_t> m_middle;
+    alignas(64) uint8_t m_read;         // reader only
+};
+
+} // namespace RF
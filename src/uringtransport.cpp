@@ -0,0 +1,391 @@
+#include <cstring>
+#include <cstdlib>
+#include <climits>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <errno.h>
+
+#include <iostream>
+
+#include "uringtransport.hpp"
+#include "rfcmd.hpp"
+
+namespace RF {
+
+static const unsigned RING_ENTRIES = 16;
+
+static int io_uring_setup(unsigned entries, struct io_uring_params* p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+static int io_uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+
+UringTransport::UringTransport()
+    : m_ring_fd(-1),
+      m_sq_ptr(MAP_FAILED),
+      m_sq_size(0),
+      m_sqes(nullptr),
+      m_sqes_size(0),
+      m_sq_pending(0),
+      m_cq_ptr(MAP_FAILED),
+      m_cq_size(0),
+      m_num_endpoints(0),
+      m_outstanding(0)
+{
+    memset(m_endpoints, 0, sizeof(m_endpoints));
+    memset(&m_deadline, 0, sizeof(m_deadline));
+    if (!setup(RING_ENTRIES)) {
+        std::cerr << "[ERROR] UringTransport: ring setup failed: " << strerror(errno) << std::endl;
+    }
+}
+
+
+UringTransport::~UringTransport() {
+    // Flush queued CLOSEs and wait for anything still in flight
+    while (m_ring_fd >= 0 && m_outstanding > 0) {
+        if (enter(m_sq_pending, m_outstanding) < 0) break;
+        reap(nullptr);
+    }
+
+    if (m_sqes) munmap(m_sqes, m_sqes_size);
+    if (m_cq_ptr != MAP_FAILED && m_cq_ptr != m_sq_ptr) munmap(m_cq_ptr, m_cq_size);
+    if (m_sq_ptr != MAP_FAILED) munmap(m_sq_ptr, m_sq_size);
+    if (m_ring_fd >= 0) close(m_ring_fd);
+}
+
+
+bool UringTransport::supported() {
+    static int cached = -1;
+    if (cached >= 0) {
+        return cached == 1;
+    }
+
+    cached = 0;
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = io_uring_setup(2, &p);
+    if (fd < 0) {
+        return false;
+    }
+
+    const size_t nops = 256;
+    size_t probe_size = sizeof(struct io_uring_probe) + nops * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe* probe = (struct io_uring_probe*)calloc(1, probe_size);
+    if (probe && io_uring_register(fd, IORING_REGISTER_PROBE, probe, nops) == 0) {
+        const int needed[] = { IORING_OP_CONNECT, IORING_OP_SEND, IORING_OP_RECV,
+                               IORING_OP_CLOSE, IORING_OP_LINK_TIMEOUT };
+        cached = 1;
+        for (size_t i = 0; i < sizeof(needed) / sizeof(needed[0]); i++) {
+            if (needed[i] > probe->last_op ||
+                !(probe->ops[needed[i]].flags & IO_URING_OP_SUPPORTED)) {
+                cached = 0;
+            }
+        }
+    }
+    free(probe);
+    close(fd);
+    return cached == 1;
+}
+
+
+bool UringTransport::setup(unsigned entries) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    m_ring_fd = io_uring_setup(entries, &p);
+    if (m_ring_fd < 0) {
+        return false;
+    }
+
+    m_sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    m_cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        m_sq_size = m_cq_size = (m_sq_size > m_cq_size) ? m_sq_size : m_cq_size;
+    }
+
+    m_sq_ptr = mmap(nullptr, m_sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    m_ring_fd, IORING_OFF_SQ_RING);
+    if (m_sq_ptr == MAP_FAILED) {
+        return false;
+    }
+    if (single_mmap) {
+        m_cq_ptr = m_sq_ptr;
+    } else {
+        m_cq_ptr = mmap(nullptr, m_cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        m_ring_fd, IORING_OFF_CQ_RING);
+        if (m_cq_ptr == MAP_FAILED) {
+            return false;
+        }
+    }
+
+    m_sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      m_ring_fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        return false;
+    }
+    m_sqes = (struct io_uring_sqe*)sqes;
+
+    char* sq = (char*)m_sq_ptr;
+    m_sq_head = (unsigned*)(sq + p.sq_off.head);
+    m_sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    m_sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+    m_sq_array = (unsigned*)(sq + p.sq_off.array);
+
+    char* cq = (char*)m_cq_ptr;
+    m_cq_head = (unsigned*)(cq + p.cq_off.head);
+    m_cq_tail = (unsigned*)(cq + p.cq_off.tail);
+    m_cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+    m_cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+    return true;
+}
+
+
+int UringTransport::add_endpoint(const char* ip, uint16_t port, size_t prewarm) {
+    (void)prewarm;  // the connect is part of every chain
+    if (m_num_endpoints >= MAX_ENDPOINTS) {
+        return -1;
+    }
+
+    struct sockaddr_in& addr = m_endpoints[m_num_endpoints];
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, ip, &addr.sin_addr) <= 0) {
+        std::cerr << "[ERROR] UringTransport: Invalid address: " << ip << std::endl;
+        return -1;
+    }
+    return m_num_endpoints++;
+}
+
+
+ssize_t UringTransport::exchange(int endpoint, const char* data, size_t len,
+                                 char* reply, size_t reply_cap, const Deadline& deadline) {
+    if (m_ring_fd < 0 || endpoint < 0 || (size_t)endpoint >= m_num_endpoints || reply_cap < 2) {
+        return -EINVAL;
+    }
+    // Only the ends are visible: connect, send and receive complete in one wait
+    m_times.start = monotonic_ns();
+    m_times.connected = m_times.sent = m_times.first_byte = 0;
+    m_times.done = m_times.start;
+    if (deadline.at_ns <= m_times.start) {
+        m_exchanges++;
+        return -ETIMEDOUT;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    m_syscalls++;
+    if (fd < 0) {
+        m_exchanges++;
+        return -errno;
+    }
+
+    // Every phase is bounded by the same absolute deadline
+    m_deadline.tv_sec = deadline.at_ns / 1000000000LL;
+    m_deadline.tv_nsec = deadline.at_ns % 1000000000LL;
+
+    struct io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_CONNECT;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)&m_endpoints[endpoint];
+    sqe->off = sizeof(m_endpoints[endpoint]);
+    sqe->flags = IOSQE_IO_LINK;
+    sqe->user_data = TAG_CONNECT;
+    prep_linked_timeout(IOSQE_IO_LINK);
+
+    sqe = get_sqe();
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)data;
+    sqe->len = len;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->flags = IOSQE_IO_LINK;
+    sqe->user_data = TAG_SEND;
+    prep_linked_timeout(IOSQE_IO_LINK);
+
+    size_t received = 0;
+    ReplyFramer framer;
+    int status = 0;
+    reply[0] = '\0';
+
+    for (;;) {
+        sqe = get_sqe();
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = fd;
+        sqe->addr = (uint64_t)(uintptr_t)(reply + received);
+        sqe->len = reply_cap - 1 - received;
+        sqe->flags = IOSQE_IO_LINK;
+        sqe->user_data = TAG_RECV;
+        prep_linked_timeout(0);
+
+        // Submit and wait for every CQE of the chain in the same call
+        int results[TAG_TIMEOUT + 1];
+        for (int i = 0; i <= TAG_TIMEOUT; i++) results[i] = INT_MIN;
+        bool timed_out = false;
+        while (m_outstanding > 0) {
+            if (enter(m_sq_pending, m_outstanding) < 0 && errno != EINTR) {
+                status = -errno;
+                break;
+            }
+            reap(results);
+            if (results[TAG_TIMEOUT] == -ETIME) timed_out = true;
+        }
+        if (status < 0) {
+            // The chain may still be in flight: its CQEs must not land in the next
+            // exchange's results, nor its RECV in a reply buffer handed back
+            drain(fd);
+            break;
+        }
+
+        int res = results[TAG_CONNECT];
+        if (res != INT_MIN && res < 0) {
+            status = timed_out ? -ETIMEDOUT : res;
+            break;
+        }
+        res = results[TAG_SEND];
+        if (res != INT_MIN && res >= 0 && (size_t)res < len) {
+            status = -EIO;
+            break;
+        }
+        if (res != INT_MIN && res < 0) {
+            status = timed_out ? -ETIMEDOUT : res;
+            break;
+        }
+        res = results[TAG_RECV];
+        if (res < 0) {
+            status = timed_out ? -ETIMEDOUT : res;
+            break;
+        }
+        if (res == 0) {
+            // Server closed before the framer saw the end of the reply: short
+            status = -ECONNRESET;
+            break;
+        }
+
+        size_t prev = received;
+        received += res;
+        reply[received] = '\0';
+        if (framer.complete(reply, received, prev)) {
+            break;
+        }
+        if (received >= reply_cap - 1) {
+            // Buffer full before the reply ended: never hand back a truncated reply
+            status = -EMSGSIZE;
+            break;
+        }
+        // Reply arrived in pieces: chain another RECV under the same deadline
+    }
+
+    // One request per connection. Goes out with the next submission.
+    if (m_ring_fd >= 0) {
+        sqe = get_sqe();
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = fd;
+        sqe->user_data = TAG_CLOSE;
+    } else {
+        close(fd);
+        m_syscalls++;
+    }
+
+    m_exchanges++;
+    m_times.done = monotonic_ns();
+    return (status < 0) ? status : (ssize_t)received;
+}
+
+
+// After io_uring_enter failed mid-exchange: shut the socket down so whatever of the
+// chain is in flight completes at once, then reap every CQE still expected. If the
+// ring can't be entered at all any more it is closed, and exchanges fail from then on.
+void UringTransport::drain(int fd) {
+    shutdown(fd, SHUT_RDWR);
+    m_syscalls++;
+    int failures = 0;
+    while (m_outstanding > 0) {
+        if (enter(m_sq_pending, m_outstanding) < 0 && errno != EINTR && ++failures >= 8) {
+            std::cerr << "[ERROR] UringTransport: can't reap the ring: " << strerror(errno) <<
+                ", closing it" << std::endl;
+            close(m_ring_fd);
+            m_ring_fd = -1;
+            m_outstanding = 0;
+            m_sq_pending = 0;
+            return;
+        }
+        reap(nullptr);
+    }
+}
+
+
+struct io_uring_sqe* UringTransport::get_sqe() {
+    unsigned tail = *m_sq_tail;
+    unsigned head = __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+    if (tail - head >= RING_ENTRIES) {
+        // Ring full (only if completions were never reaped): push what we have first
+        enter(m_sq_pending, 0);
+    }
+
+    unsigned idx = tail & *m_sq_mask;
+    struct io_uring_sqe* sqe = &m_sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    m_sq_array[idx] = idx;
+    __atomic_store_n(m_sq_tail, tail + 1, __ATOMIC_RELEASE);
+    m_sq_pending++;
+    m_outstanding++;
+    return sqe;
+}
+
+
+// Bound the preceding SQE by the exchange deadline
+void UringTransport::prep_linked_timeout(uint8_t extra_flags) {
+    struct io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_LINK_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = (uint64_t)(uintptr_t)&m_deadline;
+    sqe->len = 1;
+    sqe->timeout_flags = IORING_TIMEOUT_ABS;
+    sqe->flags = extra_flags;
+    sqe->user_data = TAG_TIMEOUT;
+}
+
+
+int UringTransport::enter(unsigned to_submit, unsigned min_complete) {
+    int ret = io_uring_enter(m_ring_fd, to_submit, min_complete,
+                             min_complete ? IORING_ENTER_GETEVENTS : 0);
+    m_syscalls++;
+    if (ret > 0) {
+        m_sq_pending -= ((unsigned)ret < m_sq_pending) ? (unsigned)ret : m_sq_pending;
+    }
+    return ret;
+}
+
+
+// Record the latest result per tag. A LINK_TIMEOUT that fired reports -ETIME.
+void UringTransport::reap(int* results) {
+    unsigned head = *m_cq_head;
+    unsigned tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+
+    while (head != tail) {
+        const struct io_uring_cqe* cqe = &m_cqes[head & *m_cq_mask];
+        unsigned tag = (unsigned)cqe->user_data;
+        if (results && tag <= TAG_TIMEOUT) {
+            if (tag != TAG_TIMEOUT || cqe->res == -ETIME) {
+                results[tag] = cqe->res;
+            }
+        }
+        head++;
+        m_outstanding--;
+    }
+    __atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+}
+
+} // namespace RF
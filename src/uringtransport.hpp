@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <linux/io_uring.h>
+
+#include "transport.hpp"
+
+namespace RF {
+
+// io_uring backend. Each exchange creates a socket and submits
+//   CONNECT -> LINK_TIMEOUT -> SEND -> LINK_TIMEOUT -> RECV -> LINK_TIMEOUT
+// as one linked chain with a single io_uring_enter, which also waits for the
+// completions. Further RECVs are only submitted if the reply arrived in pieces, and
+// the CLOSE is queued without a syscall and goes out with the next submission.
+//
+// Connections are not pre-opened: the connect is part of the chain. Uses the raw
+// syscalls so there is no liburing dependency.
+class UringTransport final : public Transport {
+public:
+    static const size_t MAX_ENDPOINTS = 16;
+
+    UringTransport();
+    ~UringTransport();
+
+    // Can a ring be created here and does the kernel support every opcode we chain?
+    static bool supported();
+
+    const char* name() const override { return "io_uring"; }
+
+    int add_endpoint(const char* ip, uint16_t port, size_t prewarm = 0) override;
+
+    ssize_t exchange(int endpoint, const char* data, size_t len,
+                     char* reply, size_t reply_cap, const Deadline& deadline) override;
+
+private:
+    enum Tag {
+        TAG_CONNECT = 1,
+        TAG_SEND,
+        TAG_RECV,
+        TAG_CLOSE,
+        TAG_TIMEOUT
+    };
+
+    int m_ring_fd;
+
+    // Submission ring
+    void* m_sq_ptr;
+    size_t m_sq_size;
+    unsigned* m_sq_head;
+    unsigned* m_sq_tail;
+    unsigned* m_sq_mask;
+    unsigned* m_sq_array;
+    struct io_uring_sqe* m_sqes;
+    size_t m_sqes_size;
+    unsigned m_sq_pending;      // prepared but not yet submitted
+
+    // Completion ring
+    void* m_cq_ptr;
+    size_t m_cq_size;
+    unsigned* m_cq_head;
+    unsigned* m_cq_tail;
+    unsigned* m_cq_mask;
+    struct io_uring_cqe* m_cqes;
+
+    struct sockaddr_in m_endpoints[MAX_ENDPOINTS];
+    size_t m_num_endpoints;
+
+    struct __kernel_timespec m_deadline;
+    unsigned m_outstanding;     // CQEs still expected for the current exchange
+
+    bool setup(unsigned entries);
+    struct io_uring_sqe* get_sqe();
+    void prep_linked_timeout(uint8_t extra_flags);
+    int enter(unsigned to_submit, unsigned min_complete);
+    void reap(int* results);
+    void drain(int fd);
+};
+
+} // namespace RF